@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "UserModelHandler.hpp"
+
+namespace social {
+
+    /**
+     * @brief Read-through, deduplicated view of UserModels shared by the searches of one batch.
+     *
+     * Offers the same read interface recommend_A_star uses on UserModelHandler (load_user_by_id,
+     * get_user_profile_view), so many searches can run against it from several threads at once.
+     * A model is loaded once per batch; profile views are derived from loaded models, and the
+     * friends of every loaded model get their views in one IN (...) query instead of one each.
+     *
+     * Database misses are serialized (the handler owns a single MYSQL connection), hits only take
+     * a shared lock. The cache is a snapshot for the lifetime of the batch, it never sees writes.
+     */
+    class BatchGraphCache final {
+    public:
+        /// Ids per IN (...) list, keeps single statements well below max_allowed_packet.
+        static constexpr size_t QUERY_CHUNK = 4096;
+
+        explicit BatchGraphCache(const UserModelHandler &ctrl) : ctrl(ctrl) {}
+
+        /// Load the models of @p seeds and the views of their friends in bulk before the searches start.
+        void prefetch(const std::vector<uint32_t> &seeds) {
+            std::lock_guard db(db_mut);
+
+            std::unordered_set<uint32_t> missing;
+            {
+                std::shared_lock lock(map_mut);
+                for (const uint32_t id: seeds) {
+                    if (!models.contains(id)) missing.insert(id);
+                }
+            }
+
+            std::unordered_map<uint32_t, UserModel> loaded;
+            for_each_chunk(missing, [&](const std::unordered_set<uint32_t> &chunk) {
+                loaded.merge(ctrl.batch_load_users_by_ids(chunk));
+            });
+
+            std::unique_lock lock(map_mut);
+            for (auto &[id, user]: loaded) {
+                models.emplace(id, user);
+            }
+            lock.unlock();
+
+            std::unordered_set<uint32_t> friend_ids;
+            for (const auto &[_, user]: loaded) {
+                collect_friends(user, friend_ids);
+            }
+            fetch_views(friend_ids);
+        }
+
+        /// Same contract as UserModelHandler::load_user_by_id, the reference stays valid for the cache lifetime.
+        [[nodiscard]] const UserModel &load_user_by_id(const uint32_t user_id) const {
+            {
+                std::shared_lock lock(map_mut);
+                if (const auto it = models.find(user_id); it != models.end()) return it->second;
+            }
+
+            std::lock_guard db(db_mut);
+            {
+                std::shared_lock lock(map_mut);
+                if (const auto it = models.find(user_id); it != models.end()) return it->second;
+            }
+
+            const UserModel user = ctrl.load_user_by_id(user_id); // throws like the single-user path
+
+            std::unique_lock lock(map_mut);
+            const auto &stored = models.emplace(user_id, user).first->second;
+            lock.unlock();
+
+            // The search scores every friend of an expanded node next
+            std::unordered_set<uint32_t> friend_ids;
+            collect_friends(stored, friend_ids);
+            fetch_views(friend_ids);
+            return stored;
+        }
+
+        /// Same contract as UserModelHandler::get_user_profile_view.
+        [[nodiscard]] UserProfileView get_user_profile_view(const uint32_t id) const {
+            {
+                std::shared_lock lock(map_mut);
+                if (const auto view = find_view(id)) return *view;
+            }
+
+            std::lock_guard db(db_mut);
+            {
+                std::shared_lock lock(map_mut);
+                if (const auto view = find_view(id)) return *view;
+            }
+
+            const UserProfileView view = ctrl.get_user_profile_view(id); // throws like the single-user path
+
+            std::unique_lock lock(map_mut);
+            views.emplace(id, view);
+            return view;
+        }
+
+        /// Models held, for diagnostics.
+        [[nodiscard]] size_t model_count() const {
+            std::shared_lock lock(map_mut);
+            return models.size();
+        }
+
+    private:
+        const UserModelHandler &ctrl;
+
+        mutable std::mutex db_mut;          /// serializes every call into ctrl
+        mutable std::shared_mutex map_mut;  /// guards models / views
+        mutable std::unordered_map<uint32_t, UserModel> models;      /// node references are stable
+        mutable std::unordered_map<uint32_t, UserProfileView> views; /// users seen only as friends
+
+        /// Requires map_mut held (shared is enough).
+        [[nodiscard]] std::optional<UserProfileView> find_view(const uint32_t id) const {
+            if (const auto it = models.find(id); it != models.end()) {
+                return UserProfileView{id, it->second.interests_16, it->second.base_64_bits};
+            }
+            if (const auto it = views.find(id); it != views.end()) return it->second;
+            return std::nullopt;
+        }
+
+        static void collect_friends(const UserModel &user, std::unordered_set<uint32_t> &out) {
+            for (const auto &[fid, _]: user.friends) {
+                if (fid != INVALID_FRIEND_ID) out.insert(fid);
+            }
+        }
+
+        /// Requires db_mut held. Unknown ids are simply left out, get_user_profile_view reports them.
+        void fetch_views(std::unordered_set<uint32_t> &ids) const {
+            {
+                std::shared_lock lock(map_mut);
+                std::erase_if(ids, [&](const uint32_t id) { return models.contains(id) || views.contains(id); });
+            }
+
+            std::unordered_map<uint32_t, UserProfileView> loaded;
+            for_each_chunk(ids, [&](const std::unordered_set<uint32_t> &chunk) {
+                loaded.merge(ctrl.batch_get_user_profile_views(chunk));
+            });
+
+            std::unique_lock lock(map_mut);
+            views.merge(loaded);
+        }
+
+        template<typename F>
+        static void for_each_chunk(const std::unordered_set<uint32_t> &ids, F &&f) {
+            std::unordered_set<uint32_t> chunk;
+            for (const uint32_t id: ids) {
+                chunk.insert(id);
+                if (chunk.size() == QUERY_CHUNK) {
+                    f(chunk);
+                    chunk.clear();
+                }
+            }
+            if (!chunk.empty()) f(chunk);
+        }
+    };
+
+}
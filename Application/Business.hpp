@@ -6,13 +6,22 @@
 #include <cstdint>
 #include <jh/pod>
 #include <random>
+#include <future>
+#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
 #include <boost/json.hpp>
 
 #include "../Entities/UserModel.hpp"
 #include "UserModelHandler.hpp"
 #include "FabricInfoHandler.hpp"
+#include "BatchGraphCache.hpp"
+#include "SearchArena.hpp"
 #include "../Entities/UserModel.hpp"
 #include "../Utils/Fabric.hpp"
+#include "../Utils/ParallelFor.hpp"
 
 
 namespace social {
@@ -28,6 +37,13 @@ namespace social {
 
     using interaction_input = std::vector<InteractionEntry>;
 
+    /// Persistence cost of one batch update.
+    JH_POD_STRUCT(PersistStats,
+                  uint32_t rows_loaded;
+                          uint32_t rows_written;
+                          uint64_t bytes_sent;
+    );
+
     inline uint8_t interest_cost(const uint8_t score) {
         // highest as 128, higher score -> lower A* cost
         if (score >= 112) return 1;
@@ -36,67 +52,325 @@ namespace social {
         return 4;
     }
 
+    /// Friends of one node, strongest interaction first.
+    struct RankedFriends {
+        pod::array<pod::pair<uint32_t, uint32_t>, 256> friends; /// <friend_id, interaction_score>
+        size_t count;
+    };
+
+    /// Rank the friends of @p node by interaction score, ties by smaller id, so every caller agrees on the order.
+    inline RankedFriends _rank_friends(const UserModel &node) {
+        RankedFriends ranked{};
+        for (const auto &entry: node.friends) {
+            if (entry.first != INVALID_FRIEND_ID) ranked.friends[ranked.count++] = entry;
+        }
+        std::sort(ranked.friends.begin(), ranked.friends.begin() + ranked.count, [](const auto &a, const auto &b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        });
+        return ranked;
+    }
+
+    /// Cost of the friend at @p rank of a _rank_friends list: full match for the top 5, basics up to 20, then 4.
+    inline uint8_t _ranked_friend_cost(const UserModel &self, const size_t rank, const UserProfileView &profile) {
+        const uint8_t basics = match_basics(self.base_64_bits, profile.base_64_bits);
+        if (rank < 5) {
+            if (basics >= HIGH_THRESHOLD) return 1;
+            if (basics < LOW_THRESHOLD) return 4;
+            return interest_cost(match_interests(self.interests_16, profile.interests_16));
+        }
+        if (rank < 20) return basics >= HIGH_THRESHOLD ? 3 : 4;
+        return 4;
+    }
+
     inline pod::array<pod::pair<uint32_t, uint8_t>, 256>
     _score_all_friends(const UserModel &self, const UserModel &node,
                        const std::unordered_map<uint32_t, social::UserProfileView> &profile_map) {
-        struct FriendInfo {
-            uint32_t id;
-            uint32_t score;
-        };
+        const RankedFriends ranked = _rank_friends(node);
 
-        FriendInfo temp[256];
-        size_t count = 0;
+        pod::array<pod::pair<uint32_t, uint8_t>, 256> result{};
 
-        for (const auto &[fid, inter]: node.friends) {
-            if (fid != INVALID_FRIEND_ID) {
-                temp[count++] = {fid, inter};
+        for (size_t i = 0; i < ranked.count; ++i) {
+            const uint32_t fid = ranked.friends[i].first;
+
+            if (fid == self.user_id || !profile_map.count(fid)) continue;
+
+            result[i] = {fid, _ranked_friend_cost(self, i, profile_map.at(fid))};
+        }
+
+        return result;
+    }
+
+
+    /// Cost of stepping onto a user with these profile columns, seen from @p self.
+    inline uint8_t _fof_edge_cost(const UserModel &self, const uint64_t interests_16, const uint64_t base_64_bits) {
+        const uint8_t basic_score = match_basics(self.base_64_bits, base_64_bits);
+        if (basic_score >= HIGH_THRESHOLD) return 1;
+        if (basic_score < LOW_THRESHOLD) return 4;
+        return interest_cost(match_interests(self.interests_16, interests_16));
+    }
+
+    /// Deepest FoF search, 4 * 63 is the largest path cost a uint8_t holds.
+    constexpr uint8_t MAX_SEARCH_DEPTH = 63;
+
+    /// Limits of one graph search; the default is unlimited.
+    struct SearchBudget {
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+        uint32_t max_expansions = UINT32_MAX;
+
+        /// Budget starting now: @p ms milliseconds (0 = no deadline) and @p nodes expansions (0 = no cap).
+        static SearchBudget from_limits(const uint32_t ms, const uint32_t nodes) {
+            SearchBudget budget{};
+            if (ms) budget.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+            if (nodes) budget.max_expansions = nodes;
+            return budget;
+        }
+    };
+
+    /// What one graph search cost.
+    JH_POD_STRUCT(SearchStats,
+                  uint32_t expansions; /// nodes whose friend list was loaded
+                          uint32_t db_calls; /// load_user_by_id + get_user_profile_view calls on the source
+                          bool partial; /// the budget ran out, some nodes were never expanded
+    );
+
+    /**
+     * Including friends -> front page or strangers (friends of friends) -> people you might know
+     * @tparam Source Anything with UserModelHandler's load_user_by_id / get_user_profile_view, e.g. BatchGraphCache.
+     * @param budget Anytime limits: once exhausted no node is expanded any more, the open set found so far
+     *               is still ranked into the result and stats->partial is set.
+     */
+    template<size_t N, typename Source = UserModelHandler>
+    pod::array<uint32_t, N>
+    recommend_A_star(const UserModel& self, const Source& ctrl, uint8_t max_depth = 4,
+                     const SearchBudget& budget = {}, SearchStats* stats = nullptr) {
+        // Path costs are at most 4 per hop and must fit the uint8_t buckets
+        max_depth = std::min<uint8_t>(max_depth, MAX_SEARCH_DEPTH);
+
+        // Dial queue: costs are popped bucket by bucket, each bucket in user_id order,
+        // which is the (cost, user_id) order of a binary heap without its log n per push
+        SearchArena& arena = search_arena();
+        arena.begin();
+
+        pod::array<uint32_t, N> result{};
+        size_t filled = 0;
+        SearchStats local{};
+
+        arena.push({self.user_id, 0, 0});
+        arena.set_best_cost(self.user_id, 0);
+
+        for (size_t c = 0; c <= arena.highest_cost() && filled < N; ++c) {
+            auto& bucket = arena.bucket(c);
+            // Edge costs are >= 1, nothing is pushed into this bucket while it is walked
+            std::sort(bucket.begin(), bucket.end(), [](const SearchArena::Node& a, const SearchArena::Node& b) {
+                return a.user_id < b.user_id;
+            });
+
+            for (size_t k = 0; k < bucket.size() && filled < N; ++k) {
+                const SearchArena::Node current = bucket[k];
+
+                // Already recommended or self
+                if (current.user_id != self.user_id && !arena.is_recommended(current.user_id)) {
+                    if (!social::is_friend(self, current.user_id)) {
+                        result[filled++] = current.user_id;
+                    }
+                    arena.mark_recommended(current.user_id);
+                }
+
+                if (current.depth >= max_depth)
+                    continue;
+
+                // Out of budget: stop expanding, the frontier already found still fills the result in cost order
+                if (local.partial || local.expansions >= budget.max_expansions ||
+                    std::chrono::steady_clock::now() >= budget.deadline) {
+                    local.partial = true;
+                    continue;
+                }
+                ++local.expansions;
+
+                const auto& node = ctrl.load_user_by_id(current.user_id);
+                ++local.db_calls;
+
+                // Lazy-load friends' profiles
+                for (const auto& [fid, _] : node.friends) {
+                    if (fid == INVALID_FRIEND_ID || arena.has_profile(fid)) continue;
+                    arena.set_profile(fid, ctrl.get_user_profile_view(fid));
+                    ++local.db_calls;
+                }
+
+                for (const auto& [fid, interaction_score] : node.friends) {
+                    if (fid == INVALID_FRIEND_ID || fid == self.user_id)
+                        continue;
+
+                    const auto& prof = arena.profile(fid);
+                    const uint8_t cost = _fof_edge_cost(self, prof.interests_16, prof.base_64_bits);
+
+                    const auto new_cost = static_cast<uint8_t>(current.cost + cost);
+                    if (!arena.reached(fid) || new_cost < arena.best_cost(fid)) {
+                        arena.set_best_cost(fid, new_cost);
+                        arena.push({fid, new_cost, static_cast<uint8_t>(current.depth + 1)});
+                    }
+                }
             }
         }
 
-        std::sort(temp, temp + count, [](const FriendInfo &a, const FriendInfo &b) {
-            return b.score < a.score;
-        });
+        if (stats) *stats = local;
+        return result;
+    }
 
-        pod::array<pod::pair<uint32_t, uint8_t>, 256> result{};
+    /// Loads of one cost level (friend lists or profiles) below which they stay on the calling thread.
+    constexpr size_t PARALLEL_FRONTIER_MIN = 32;
+
+    /**
+     * @brief recommend_A_star with every cost level expanded in parallel; same result for the same data.
+     *
+     * Level-synchronous: when the walk reaches bucket c, the recommendations and the set of nodes to
+     * expand are decided serially (they only depend on earlier levels). The friend lists of those nodes
+     * are then loaded on a work-stealing parallel_for, followed by the profiles of their friends that
+     * this search has not seen yet, each once. Costs and pushes are worked out serially in node order
+     * with the serial best-cost rule, so the pushes equal those of recommend_A_star and so do the loads,
+     * except on the level that fills the result: there the serial walk still expands the nodes before
+     * the last recommendation, this one loads nothing. Levels with fewer than PARALLEL_FRONTIER_MIN
+     * loads run inline.
+     *
+     * @tparam Source Must be safe to call from several threads (e.g. BatchGraphCache, not UserModelHandler).
+     * @param budget The deadline is checked once per level; max_expansions is exact.
+     */
+    template<size_t N, typename Source>
+    pod::array<uint32_t, N>
+    recommend_A_star_parallel(const UserModel &self, const Source &ctrl, uint8_t max_depth = 4,
+                              const SearchBudget &budget = {}, SearchStats *stats = nullptr) {
+        max_depth = std::min<uint8_t>(max_depth, MAX_SEARCH_DEPTH);
+
+        SearchArena &arena = search_arena();
+        arena.begin();
+
+        // Kept per calling thread, capacity survives between levels and searches.
+        // Bound to references so the workers see the caller's buffers, not their own thread_locals.
+        thread_local std::vector<SearchArena::Node> expand_buffer;
+        thread_local std::vector<std::vector<uint32_t>> friend_buffers;
+        thread_local std::vector<uint32_t> missing_buffer;
+        thread_local std::vector<UserProfileView> view_buffer;
+        auto &expand = expand_buffer;
+        auto &friends = friend_buffers;
+        auto &missing = missing_buffer;
+        auto &views = view_buffer;
 
-        for (size_t i = 0; i < count; ++i) {
-            const uint32_t fid = temp[i].id;
+        pod::array<uint32_t, N> result{};
+        size_t filled = 0;
+        SearchStats local{};
 
-            if (fid == self.user_id || !profile_map.count(fid)) continue;
+        arena.push({self.user_id, 0, 0});
+        arena.set_best_cost(self.user_id, 0);
 
-            const auto &[_, interests_16, base_64_bits] = profile_map.at(fid);
-            const uint8_t basics = match_basics(self.base_64_bits, base_64_bits);
+        const auto for_each_index = [](const size_t n, auto &&body) {
+            if (n < PARALLEL_FRONTIER_MIN) {
+                for (size_t i = 0; i < n; ++i) body(i);
+            } else {
+                fabric::parallel_for(n, 4, body);
+            }
+        };
 
-            uint8_t cost = 4;
+        for (size_t c = 0; c <= arena.highest_cost() && filled < N; ++c) {
+            auto &bucket = arena.bucket(c);
+            std::sort(bucket.begin(), bucket.end(), [](const SearchArena::Node &a, const SearchArena::Node &b) {
+                return a.user_id < b.user_id;
+            });
 
-            if (i < 5) {
-                if (basics >= HIGH_THRESHOLD)
-                    cost = 1;
-                else if (basics < LOW_THRESHOLD)
-                    cost = 4;
-                else
-                    cost = interest_cost(match_interests(self.interests_16, interests_16));
-            } else if (i < 20) {
-                cost = (basics >= HIGH_THRESHOLD) ? 3 : 4;
+            // Serial: recommendations of this level and which of its nodes get expanded
+            expand.clear();
+            const bool out_of_time = std::chrono::steady_clock::now() >= budget.deadline;
+            for (size_t k = 0; k < bucket.size() && filled < N; ++k) {
+                const SearchArena::Node current = bucket[k];
+
+                if (current.user_id != self.user_id && !arena.is_recommended(current.user_id)) {
+                    if (!social::is_friend(self, current.user_id)) {
+                        result[filled++] = current.user_id;
+                    }
+                    arena.mark_recommended(current.user_id);
+                }
+
+                if (current.depth >= max_depth) continue;
+                if (local.partial || out_of_time || local.expansions >= budget.max_expansions) {
+                    local.partial = true;
+                    continue;
+                }
+                ++local.expansions;
+                expand.push_back(current);
+            }
+            if (expand.empty()) continue;
+            if (filled == N) {
+                // Full: the serial walk would still load these, nothing they push can be recommended
+                local.expansions -= static_cast<uint32_t>(expand.size());
+                break;
             }
 
-            result[i] = {fid, cost};
+            // Parallel: the friend lists of this level
+            if (friends.size() < expand.size()) friends.resize(expand.size());
+            for_each_index(expand.size(), [&](const size_t i) {
+                auto &out = friends[i];
+                out.clear();
+                for (const auto &[fid, _]: ctrl.load_user_by_id(expand[i].user_id).friends) {
+                    if (fid != INVALID_FRIEND_ID) out.push_back(fid);
+                }
+            });
+            local.db_calls += static_cast<uint32_t>(expand.size());
+
+            // Parallel: profiles not loaded earlier in this search, one load per user as in the serial walk
+            missing.clear();
+            for (size_t i = 0; i < expand.size(); ++i) {
+                for (const uint32_t fid: friends[i]) {
+                    if (!arena.has_profile(fid)) missing.push_back(fid);
+                }
+            }
+            std::sort(missing.begin(), missing.end());
+            missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+            views.resize(missing.size());
+            for_each_index(missing.size(), [&](const size_t j) { views[j] = ctrl.get_user_profile_view(missing[j]); });
+            for (size_t j = 0; j < missing.size(); ++j) arena.set_profile(missing[j], views[j]);
+            local.db_calls += static_cast<uint32_t>(missing.size());
+
+            // Serial: costs and pushes in node order, exactly the pushes the serial search makes
+            for (size_t i = 0; i < expand.size(); ++i) {
+                const SearchArena::Node current = expand[i];
+                for (const uint32_t fid: friends[i]) {
+                    if (fid == self.user_id) continue;
+                    const auto &prof = arena.profile(fid);
+                    const auto new_cost = static_cast<uint8_t>(current.cost +
+                                                               _fof_edge_cost(self, prof.interests_16, prof.base_64_bits));
+                    if (!arena.reached(fid) || new_cost < arena.best_cost(fid)) {
+                        arena.set_best_cost(fid, new_cost);
+                        arena.push({fid, new_cost, static_cast<uint8_t>(current.depth + 1)});
+                    }
+                }
+            }
         }
 
+        if (stats) *stats = local;
         return result;
     }
 
-
-    /// Including friends -> front page or strangers (friends of friends) -> people you might know
-    template<size_t N>
+    /**
+     * @brief Beam variant of recommend_A_star: each expanded node only pushes its top-B friends.
+     *
+     * Friends are ranked once by interaction strength (ties by smaller id); the first B of that ranking,
+     * self aside, are the only ties that need a profile lookup, are costed by their rank as in
+     * _score_all_friends, and bound the frontier growth per node.
+     * Ordering (cost, then user_id) and the budget behave exactly as in recommend_A_star.
+     *
+     * @tparam B Beam width, a compile-time constant so per-node buffers stay on the stack.
+     */
+    template<size_t N, size_t B, typename Source = UserModelHandler>
     pod::array<uint32_t, N>
-    recommend_A_star(const UserModel& self, const UserModelHandler& ctrl, uint8_t max_depth = 4) {
+    recommend_beam(const UserModel &self, const Source &ctrl, uint8_t max_depth = 4,
+                   const SearchBudget &budget = {}, SearchStats *stats = nullptr) {
+        static_assert(B > 0 && B < 256, "beam width must be within one friend list");
+
         struct Node {
             uint32_t user_id;
             uint8_t cost;
             uint8_t depth;
 
-            bool operator>(const Node& other) const {
+            bool operator>(const Node &other) const {
                 if (cost != other.cost) return cost > other.cost;
                 return user_id > other.user_id;
             }
@@ -109,6 +383,7 @@ namespace social {
 
         pod::array<uint32_t, N> result{};
         size_t filled = 0;
+        SearchStats local{};
 
         open.push({self.user_id, 0, 0});
         best_cost[self.user_id] = 0;
@@ -117,7 +392,6 @@ namespace social {
             Node current = open.top();
             open.pop();
 
-            // Already recommended or self
             if (current.user_id != self.user_id && !recommended.contains(current.user_id)) {
                 if (!social::is_friend(self, current.user_id)) {
                     result[filled++] = current.user_id;
@@ -128,38 +402,31 @@ namespace social {
             if (current.depth >= max_depth)
                 continue;
 
-            const UserModel node = ctrl.load_user_by_id(current.user_id);
-
-            // Lazy-load friends' profiles
-            for (const auto& [fid, _] : node.friends) {
-                if (fid == INVALID_FRIEND_ID) continue;
-                if (!profile_map.contains(fid)) {
-                    profile_map[fid] = ctrl.get_user_profile_view(fid);
-                }
+            if (local.partial || local.expansions >= budget.max_expansions ||
+                std::chrono::steady_clock::now() >= budget.deadline) {
+                local.partial = true;
+                continue;
             }
-
-            for (const auto& [fid, interaction_score] : node.friends) {
-                if (fid == INVALID_FRIEND_ID || fid == self.user_id)
-                    continue;
-
-                // Lazy-load if still missing
-                if (!profile_map.contains(fid)) {
-                    profile_map[fid] = ctrl.get_user_profile_view(fid);
+            ++local.expansions;
+
+            const auto &node = ctrl.load_user_by_id(current.user_id);
+            ++local.db_calls;
+
+            // One ranking picks the B strongest ties, loads exactly their profiles and prices them by rank
+            const RankedFriends ranked = _rank_friends(node);
+            size_t taken = 0;
+            for (size_t i = 0; i < ranked.count && taken < B; ++i) {
+                const uint32_t fid = ranked.friends[i].first;
+                if (fid == self.user_id) continue;
+                ++taken;
+
+                auto profile = profile_map.find(fid);
+                if (profile == profile_map.end()) {
+                    profile = profile_map.emplace(fid, ctrl.get_user_profile_view(fid)).first;
+                    ++local.db_calls;
                 }
 
-                const auto& prof = profile_map.at(fid);
-                const uint8_t basic_score = match_basics(self.base_64_bits, prof.base_64_bits);
-
-                uint8_t cost = 4; // default
-                if (basic_score >= HIGH_THRESHOLD) {
-                    cost = 1;
-                } else if (basic_score < LOW_THRESHOLD) {
-                    cost = 4;
-                } else {
-                    cost = interest_cost(match_interests(self.interests_16, prof.interests_16));
-                }
-
-                uint8_t new_cost = current.cost + cost;
+                const auto new_cost = static_cast<uint8_t>(current.cost + _ranked_friend_cost(self, i, profile->second));
                 if (!best_cost.contains(fid) || new_cost < best_cost[fid]) {
                     best_cost[fid] = new_cost;
                     open.push({fid, new_cost, static_cast<uint8_t>(current.depth + 1)});
@@ -167,9 +434,65 @@ namespace social {
             }
         }
 
+        if (stats) *stats = local;
+        return result;
+    }
+
+    /// Non-friends with the most common friends, read from the user's CommonFriendTable without any graph search.
+    template<size_t N>
+    pod::array<uint32_t, N> recommend_common_friends(const UserModel &self, const UserModelHandler &ctrl) {
+        const auto ranked = ctrl.common_friend_table(self).ranked();
+
+        pod::array<uint32_t, N> result{};
+        for (size_t i = 0; i < std::min(N, ranked.size()); ++i) {
+            result[i] = ranked[i].candidate_id;
+        }
         return result;
     }
 
+    /// Most user ids accepted by one recommend_A_star_batch call.
+    constexpr size_t FOF_BATCH_MAX = 4096;
+
+    template<size_t N>
+    struct BatchRecommendation {
+        uint32_t user_id;
+        pod::array<uint32_t, N> recommendations; /// unused entries are INVALID_FRIEND_ID
+        std::string error;                       /// non-empty if this user's search threw
+    };
+
+    /**
+     * @brief recommend_A_star for many users at once, over one shared BatchGraphCache.
+     *
+     * Seeds and their friends' views are prefetched in bulk, every model touched by any search is
+     * loaded once. Searches run on fabric::parallel_for, so they land on the persistent pool threads
+     * and reuse their warm SearchArenas. Each result equals the single-user call on the same data.
+     *
+     * @return One entry per input id, in input order.
+     */
+    template<size_t N>
+    std::vector<BatchRecommendation<N>>
+    recommend_A_star_batch(const std::vector<uint32_t> &user_ids, const UserModelHandler &ctrl,
+                           const uint8_t max_depth = 4) {
+        std::vector<BatchRecommendation<N>> results(user_ids.size());
+        if (user_ids.empty()) return results;
+
+        BatchGraphCache cache(ctrl);
+        cache.prefetch(user_ids);
+
+        fabric::parallel_for(user_ids.size(), 1, [&](const size_t i) {
+            auto &out = results[i];
+            out.user_id = user_ids[i];
+            try {
+                out.recommendations = recommend_A_star<N>(cache.load_user_by_id(user_ids[i]), cache, max_depth);
+            } catch (const std::exception &e) {
+                out.recommendations = {};
+                out.error = e.what();
+            }
+        });
+
+        return results;
+    }
+
     template<size_t N>
     pod::array<uint32_t, N> recommend_strangers(const UserModel &self, const UserModelHandler &ctrl) {
         using Candidate = std::pair<uint32_t, uint8_t>; // <user_id, match_basics_score>
@@ -223,27 +546,66 @@ namespace social {
         return result;
     }
 
-    inline uint32_t _batch_update_interactions(UserModelHandler &ctrl, const interaction_input &interactions) {
-        if (interactions.empty()) return 0;
+    /// Exact variant: the N users with the highest match_basics over the whole population (HammingIndex).
+    template<size_t N>
+    pod::array<uint32_t, N> recommend_strangers_exact(const UserModel &self, const UserModelHandler &ctrl) {
+        const auto friends = sorted_friend_ids(self);
+        const auto hits = ctrl.basics_index().nearest<N>(self.base_64_bits, [&](const uint32_t id) {
+            return id == self.user_id || std::binary_search(friends.begin(), friends.end(), id);
+        });
 
-        uint32_t new_friends = 0;
+        pod::array<uint32_t, N> result{};
+        for (size_t i = 0; i < N; ++i) {
+            result[i] = hits[i].first;
+        }
+        return result;
+    }
 
-        // Load all user_ids into memory first
-        std::unordered_set<uint32_t> all_ids;
-        for (const auto &[u1, u2, _]: interactions) {
-            all_ids.insert(u1);
-            all_ids.insert(u2);
+    /// Full-scan variant: the N users with the highest match_basics + match_interests (ProfileColumns).
+    template<size_t N>
+    pod::array<uint32_t, N> recommend_strangers_scan(const UserModel &self, const UserModelHandler &ctrl) {
+        // Reused per thread: only the bits set below are ever non-zero between calls
+        thread_local std::vector<uint64_t> excluded;
+        const auto mark = [&](const uint32_t id, const bool on) {
+            if (id / 64 >= excluded.size()) excluded.resize(id / 64 + 1, 0);
+            if (on) excluded[id / 64] |= uint64_t{1} << (id % 64);
+            else excluded[id / 64] &= ~(uint64_t{1} << (id % 64));
+        };
+
+        mark(self.user_id, true);
+        for (const auto &[fid, _]: self.friends) {
+            if (fid != INVALID_FRIEND_ID) mark(fid, true);
         }
 
-        std::unordered_map<uint32_t, UserModel> user_map;
-        for (uint32_t id: all_ids) {
-            user_map.emplace(id, ctrl.load_user_by_id(id));
+        const auto hits = ctrl.profile_columns().top_k<N>(self.interests_16, self.base_64_bits, excluded);
+
+        mark(self.user_id, false);
+        for (const auto &[fid, _]: self.friends) {
+            if (fid != INVALID_FRIEND_ID) mark(fid, false);
         }
 
-        // Process all interactions
+        pod::array<uint32_t, N> result{};
+        for (size_t i = 0; i < N; ++i) {
+            result[i] = hits[i].first;
+        }
+        return result;
+    }
+
+    /// Rows per dirty UPDATE statement.
+    constexpr size_t DIRTY_BATCH = 256;
+
+    /// Apply @p interactions to the models in @p user_map, @return the friendships made.
+    inline uint32_t _apply_interactions(std::unordered_map<uint32_t, UserModel> &user_map,
+                                        const interaction_input &interactions) {
+        uint32_t new_friends = 0;
+
         for (const auto &[u1, u2, score]: interactions) {
-            auto &user1 = user_map[u1];
-            auto &user2 = user_map[u2];
+            const auto it1 = user_map.find(u1);
+            const auto it2 = user_map.find(u2);
+            if (it1 == user_map.end() || it2 == user_map.end()) [[unlikely]] continue; // row not in DB
+
+            auto &user1 = it1->second;
+            auto &user2 = it2->second;
 
             const bool already_friends = social::find_friend_index(user1, u2) != INVALID_INDEX;
 
@@ -261,26 +623,85 @@ namespace social {
                 } // else: skip, no room for friendship (unlikely case)
             }
         }
+        return new_friends;
+    }
+
+    /**
+     * @brief Decay every model of @p user_map and write back what differs from @p persisted.
+     * @param persisted The same users as stored in the database, before _apply_interactions.
+     */
+    inline void _persist_interactions(UserModelHandler &ctrl, const std::unordered_map<uint32_t, UserModel> &persisted,
+                                      std::unordered_map<uint32_t, UserModel> &user_map, PersistStats &stats) {
+        // Write back only what changed, in batches of DIRTY_BATCH, every batch flushed exactly once
+        std::vector<DirtyUser> buffer;
+        buffer.reserve(DIRTY_BATCH);
+        std::vector<ListChange> relisted; /// users of buffer whose set of friends changed
+        std::unordered_set<uint32_t> written; /// flushed by an earlier batch
+
+        // A list outside the current batch, as the database holds it now
+        const auto load = [&](const uint32_t id) -> UserModel {
+            if (written.contains(id)) return user_map.at(id);
+            if (const auto it = persisted.find(id); it != persisted.end()) return it->second;
+            return ctrl.load_user_by_id(id);
+        };
+
+        const auto flush = [&] {
+            std::vector<uint32_t> ids;
+            ids.reserve(relisted.size());
+            for (const auto &[_, after]: relisted) ids.push_back(after->user_id);
 
-        // Save in batches of 256
-        std::vector<UserModel> buffer;
-        buffer.reserve(256);
+            auto write = ctrl.common_friends().begin_write(std::move(ids));
+            stats.bytes_sent += ctrl.batch_update_dirty(buffer);
+            stats.rows_written += static_cast<uint32_t>(buffer.size());
+            write.commit(relisted, load);
+
+            for (const DirtyUser &d: buffer) written.insert(d.user->user_id);
+            buffer.clear();
+            relisted.clear();
+        };
 
         for (auto &[id, user]: user_map) {
 
             /// For simplicity, decay interactions before saving
             social::decay_interactions(user);
-            buffer.emplace_back(user);
 
-            if (buffer.size() == 256) {
-                ctrl.batch_insert_users(buffer);
-                buffer.clear();
-            }
+            const UserModel &before = persisted.at(id);
+            const UserDirtyMask mask = diff_user(before, user);
+            if (!mask.any()) continue;
+
+            if (mask.any_slot() && !social::same_friends(before, user)) relisted.push_back({&before, &user});
+
+            buffer.push_back({&user, mask});
+            if (buffer.size() == DIRTY_BATCH) flush();
         }
+        if (!buffer.empty()) flush();
+
+#ifdef DEBUG
+        ctrl.verify_common_friends(); // every cached table must still bound a recount
+#endif
+    }
 
-        auto batch_map = ctrl.batch_load_users_by_ids(all_ids);
-        user_map.insert(batch_map.begin(), batch_map.end());
+    inline uint32_t _batch_update_interactions(UserModelHandler &ctrl, const interaction_input &interactions,
+                                               PersistStats *stats = nullptr) {
+        if (interactions.empty()) return 0;
+
+        // Load all user_ids into memory first, one round trip
+        std::unordered_set<uint32_t> all_ids;
+        for (const auto &[u1, u2, _]: interactions) {
+            all_ids.insert(u1);
+            all_ids.insert(u2);
+        }
 
+        const std::unordered_map<uint32_t, UserModel> persisted = ctrl.batch_load_users_by_ids(all_ids);
+        std::unordered_map<uint32_t, UserModel> user_map = persisted;
+
+        const uint32_t new_friends = _apply_interactions(user_map, interactions);
+
+        PersistStats local{};
+        local.rows_loaded = static_cast<uint32_t>(persisted.size());
+        _persist_interactions(ctrl, persisted, user_map, local);
+
+        if (stats) *stats = local;
         return new_friends;
     }
 }
@@ -290,6 +711,7 @@ namespace fabric::api {
                   uint32_t new_users;
                           uint32_t new_friendships;
                           uint32_t total_interactions;
+                          social::PersistStats persistence;
     );
 
     inline void clear_all(social::UserModelHandler &user_handler, FabricInfoHandler &fabric_handler) {
@@ -297,102 +719,131 @@ namespace fabric::api {
         fabric_handler.clear_all();
     }
 
-    inline uint32_t _generate_users(uint32_t
-                                   start_id,
-                                   uint32_t count, social::UserModelHandler
-                                   &user_handler,
-                                   FabricInfoHandler &fabric_handler
-    ) {
+    /// Users generated per task; one chunk is also one bulk INSERT per table.
+    constexpr uint32_t GENERATION_CHUNK = 2048;
+
+    struct GeneratedChunk {
         std::vector<UsersFabric> fabric_entries;
         std::vector<social::UserModel> user_models;
-
-        std::uniform_int_distribution<uint32_t> fname_dist(0, 63);
-        std::uniform_int_distribution<uint32_t> lname_dist(0, 127);
-        std::uniform_int_distribution<uint32_t> avatar_dist(0, 31);
-        auto &rng = global_rng();
-
-        for (
-                uint64_t i = 0;
-                i < count;
-                ++i) {
-            uint32_t id = start_id + i;
-            uint32_t first_name_id = fname_dist(rng);
-            uint32_t last_name_id = lname_dist(rng);
-            uint32_t avatar_id = avatar_dist(rng);
-            uint64_t interests = generate_random_interests();
-            uint64_t tags = generate_random_tags();
-
-            fabric_entries.
-                    emplace_back(id, first_name_id, last_name_id, avatar_id
-            );
-            user_models.
-                    emplace_back(id, interests, tags
-            );
+    };
+
+    /// Users of a chunk only befriend each other, so chunks are independent and may be built on any thread.
+    inline GeneratedChunk _generate_chunk(const uint32_t start_id, const uint32_t count, rng_engine rng) {
+        GeneratedChunk chunk;
+        chunk.fabric_entries.resize(count);
+        chunk.user_models.resize(count);
+
+        for (uint32_t i = 0; i < count; ++i) {
+            // 6 + 7 + 5 bits: first name (64), surname (128), avatar (32)
+            const uint64_t r = rng();
+            chunk.fabric_entries[i] = UsersFabric{start_id + i,
+                                                  static_cast<uint32_t>(r & 0x3F),
+                                                  static_cast<uint32_t>((r >> 6) & 0x7F),
+                                                  static_cast<uint32_t>((r >> 13) & 0x1F)};
+
+            auto &user = chunk.user_models[i];
+            user.user_id = start_id + i;
+            user.interests_16 = generate_random_interests(rng);
+            user.base_64_bits = generate_random_tags(rng);
         }
 
-        std::uniform_int_distribution<size_t> pick_dist(0, user_models.size() - 1);
-
-        for (
-            auto &user
-                : user_models) {
-            for (
-                    int attempt = 0;
-                    attempt < 10; ++attempt) {
-                size_t j = pick_dist(rng);
-                auto &other = user_models[j];
-                if (user.user_id == other.user_id) continue;
-
-                if (
-                        social::find_friend_index(user, other
-                                .user_id) != INVALID_INDEX) {
-                    social::add_interaction(user, other
-                            .user_id, 5);
-                    social::add_interaction(other, user
-                            .user_id, 5);
-                } else if (
-                        social::add_friend_mutual(user, other
-                        )) {
-                    social::add_interaction(user, other
-                            .user_id);
-                    social::add_interaction(other, user
-                            .user_id);
+        // Fresh users fill friend slots front to back, only the first degree[i] slots are ever scanned
+        std::vector<uint16_t> degree(count, 0);
+        const auto slot_of = [&](const uint32_t i, const uint32_t friend_id) -> uint16_t {
+            const auto &friends = chunk.user_models[i].friends;
+            for (uint16_t k = 0; k < degree[i]; ++k) {
+                if (friends[k].first == friend_id) return k;
+            }
+            return INVALID_INDEX;
+        };
+
+        for (uint32_t i = 0; i < count; ++i) {
+            auto &user = chunk.user_models[i];
+            for (int attempt = 0; attempt < 10; ++attempt) {
+                const auto j = static_cast<uint32_t>(((rng() & 0xFFFFFFFF) * count) >> 32);
+                if (i == j) continue;
+                auto &other = chunk.user_models[j];
+
+                if (const uint16_t k = slot_of(i, other.user_id); k != INVALID_INDEX) {
+                    user.friends[k].second += 5;
+                    other.friends[slot_of(j, user.user_id)].second += 5;
+                } else if (degree[i] < social::friend_list::size() && degree[j] < social::friend_list::size()) {
+                    // add_friend_mutual (10) + add_interaction (1)
+                    user.friends[degree[i]++] = {other.user_id, 11};
+                    other.friends[degree[j]++] = {user.user_id, 11};
                 }
             }
         }
 
-        fabric_handler.
-                batch_insert_users(fabric_entries);
-        user_handler.
-                batch_insert_users(user_models);
-        return
-                count;
+        return chunk;
     }
 
+    /**
+     * @brief Generate users [start_id, start_id + count) and persist them.
+     *
+     * Chunks are generated in parallel and written to the bulk writers in id order as soon as they are
+     * ready, while later chunks are still being generated. Every chunk owns a stream split from @p rng
+     * up front, so the population depends only on the seed, never on the number of threads.
+     */
+    inline uint32_t _generate_users(const uint32_t start_id,
+                                   const uint32_t count,
+                                   social::UserModelHandler &user_handler,
+                                   FabricInfoHandler &fabric_handler,
+                                   rng_engine &rng = global_rng()) {
+        if (count == 0) return 0;
+
+        const uint32_t chunks = (count + GENERATION_CHUNK - 1) / GENERATION_CHUNK;
+        const uint32_t workers = std::clamp(std::thread::hardware_concurrency(), 1u, chunks);
+
+        std::vector<rng_engine> streams;
+        streams.reserve(chunks);
+        for (uint32_t c = 0; c < chunks; ++c) {
+            streams.emplace_back(rng.split());
+        }
+
+        std::vector<std::future<GeneratedChunk>> pending(chunks);
+        const auto launch = [&](const uint32_t c) {
+            const uint32_t offset = c * GENERATION_CHUNK;
+            pending[c] = std::async(std::launch::async, _generate_chunk,
+                                    start_id + offset, std::min(GENERATION_CHUNK, count - offset), streams[c]);
+        };
+
+        for (uint32_t c = 0; c < workers; ++c) launch(c);
+
+        for (uint32_t c = 0; c < chunks; ++c) {
+            const GeneratedChunk chunk = pending[c].get();
+            if (c + workers < chunks) launch(c + workers);
+
+            // UsersFabric first: UserModels references it
+            fabric_handler.batch_insert_users(chunk.fabric_entries);
+            user_handler.batch_insert_users(chunk.user_models);
+        }
+
+        return count;
+    }
+
+    /// Pass a locally seeded rng_engine to replay the exact same population.
     inline uint32_t initialize_population(social::UserModelHandler &user_handler,
-                                          FabricInfoHandler &fabric_handler) {
+                                          FabricInfoHandler &fabric_handler,
+                                          rng_engine &rng = global_rng()) {
         std::uniform_int_distribution<uint32_t> dist(64, 128);
-        uint32_t count = dist(global_rng());
-        _generate_users(1, count, user_handler, fabric_handler);
+        uint32_t count = dist(rng);
+        _generate_users(1, count, user_handler, fabric_handler, rng);
         return count;
     }
 
 
-    DayResult next_day(social::UserModelHandler &user_handler,
-                       FabricInfoHandler &fabric_handler) {
-
-        const uint32_t total = fabric_handler.get_count();
-        if (total < 3) initialize_population(user_handler, fabric_handler);
-
+    /// The interactions of a day over a population of @p total users.
+    inline social::interaction_input _draw_interactions(const uint32_t total, rng_engine &rng) {
         std::uniform_int_distribution<uint32_t> total_interact_dist(
                 std::max(2048u, total * 2), std::max(4096u, total * 3));
-        uint32_t total_interactions = total_interact_dist(global_rng());
+        uint32_t total_interactions = total_interact_dist(rng);
 
         social::interaction_input interactions;
         interactions.reserve(total_interactions);
 
         std::uniform_int_distribution<uint32_t> id_dist(1, total);
         std::uniform_int_distribution<uint32_t> score_dist(1, 30);
-        auto &rng = global_rng();
 
         for (uint32_t i = 0; i < total_interactions; ++i) {
             uint32_t u1 = id_dist(rng);
@@ -401,22 +852,161 @@ namespace fabric::api {
             uint32_t score = score_dist(rng);
             interactions.emplace_back(u1, u2, score);
         }
+        return interactions;
+    }
 
-        uint32_t new_friendships = social::_batch_update_interactions(user_handler, interactions);
-
+    /// Users joining at the end of a day that started with @p total users.
+    inline uint32_t _draw_new_user_count(const uint32_t total, rng_engine &rng) {
         std::uniform_int_distribution<uint32_t> new_user_dist(
                 std::min(256u, total / 20), std::max(1024u, total / 20));
-        uint32_t new_user_count = new_user_dist(global_rng());
+        return new_user_dist(rng);
+    }
+
+    /// Same seed + same starting database -> same day; the engine is never shared with other sessions.
+    DayResult next_day(social::UserModelHandler &user_handler,
+                       FabricInfoHandler &fabric_handler,
+                       rng_engine &rng = global_rng()) {
+
+        const uint32_t total = fabric_handler.get_count();
+        if (total < 3) initialize_population(user_handler, fabric_handler, rng);
+
+        const social::interaction_input interactions = _draw_interactions(total, rng);
 
-        _generate_users(total + 1, new_user_count, user_handler, fabric_handler);
+        social::PersistStats persistence{};
+        uint32_t new_friendships = social::_batch_update_interactions(user_handler, interactions, &persistence);
+
+        const uint32_t new_user_count = _draw_new_user_count(total, rng);
+
+        _generate_users(total + 1, new_user_count, user_handler, fabric_handler, rng);
 
         return DayResult{
                 .new_users = new_user_count,
                 .new_friendships = new_friendships,
-                .total_interactions = static_cast<uint32_t>(interactions.size())
+                .total_interactions = static_cast<uint32_t>(interactions.size()),
+                .persistence = persistence
         };
     }
 
+    /// Most days one simulate_days call runs.
+    constexpr uint32_t SIMULATE_DAYS_MAX = 365;
+    /// Models simulate_days keeps in memory (~2 KiB each) before it starts its working set over.
+    constexpr size_t WORKING_SET_MAX = size_t{1} << 16;
+
+    /// Everything of one day that depends only on the rng, so it can be drawn while earlier days are written.
+    struct DayPlan {
+        uint32_t total; /// population at the start of the day
+        social::interaction_input interactions;
+        uint32_t new_user_count;
+        std::vector<GeneratedChunk> new_users; /// ids total + 1 .. total + new_user_count, in order
+    };
+
+    /// Draws from @p rng in exactly the order next_day does, new users included.
+    inline DayPlan _plan_day(const uint32_t total, rng_engine &rng) {
+        DayPlan plan{total, _draw_interactions(total, rng), _draw_new_user_count(total, rng), {}};
+
+        // Same streams _generate_users would split, so the same users
+        const uint32_t chunks = (plan.new_user_count + GENERATION_CHUNK - 1) / GENERATION_CHUNK;
+        std::vector<rng_engine> streams;
+        streams.reserve(chunks);
+        for (uint32_t c = 0; c < chunks; ++c) {
+            streams.emplace_back(rng.split());
+        }
+
+        plan.new_users.reserve(chunks);
+        for (uint32_t c = 0; c < chunks; ++c) {
+            const uint32_t offset = c * GENERATION_CHUNK;
+            plan.new_users.push_back(_generate_chunk(total + 1 + offset,
+                                                     std::min(GENERATION_CHUNK, plan.new_user_count - offset),
+                                                     streams[c]));
+        }
+        return plan;
+    }
+
+    /**
+     * @brief Run @p days days, the same as calling next_day that many times with @p rng.
+     *
+     * Pipelined: while one day is loaded, applied and written, the next day's interactions and new users
+     * are already being drawn on another thread. The database stays on the calling thread (the handlers
+     * share one connection). Models touched or created during the run stay in a working set, so a
+     * user is loaded at most once per run (up to WORKING_SET_MAX models); rows_loaded counts only real loads.
+     */
+    inline std::vector<DayResult> simulate_days(uint32_t days,
+                                                social::UserModelHandler &user_handler,
+                                                FabricInfoHandler &fabric_handler,
+                                                rng_engine &rng = global_rng()) {
+        std::vector<DayResult> results;
+        if (days == 0) return results;
+        results.reserve(days);
+
+        // An empty database is bootstrapped by next_day itself
+        uint32_t total = fabric_handler.get_count();
+        if (total < 3) {
+            results.push_back(next_day(user_handler, fabric_handler, rng));
+            total = fabric_handler.get_count();
+            --days;
+        }
+
+        const auto plan = [&rng](const uint32_t start) {
+            return std::async(std::launch::async, [&rng, start] { return _plan_day(start, rng); });
+        };
+
+        std::unordered_map<uint32_t, social::UserModel> working;
+        std::future<DayPlan> pending;
+        if (days > 0) pending = plan(total);
+
+        for (uint32_t d = 0; d < days; ++d) {
+            DayPlan day = pending.get();
+            if (d + 1 < days) pending = plan(day.total + day.new_user_count);
+
+            // Only users this run has not seen yet come from the database
+            std::unordered_set<uint32_t> missing;
+            for (const auto &[u1, u2, _]: day.interactions) {
+                if (!working.contains(u1)) missing.insert(u1);
+                if (!working.contains(u2)) missing.insert(u2);
+            }
+
+            social::PersistStats persistence{};
+            auto loaded = user_handler.batch_load_users_by_ids(missing);
+            persistence.rows_loaded = static_cast<uint32_t>(loaded.size());
+            working.merge(loaded);
+
+            std::unordered_map<uint32_t, social::UserModel> persisted;
+            for (const auto &[u1, u2, _]: day.interactions) {
+                for (const uint32_t id: {u1, u2}) {
+                    if (const auto it = working.find(id); it != working.end()) persisted.emplace(id, it->second);
+                }
+            }
+            std::unordered_map<uint32_t, social::UserModel> user_map = persisted;
+
+            const uint32_t new_friendships = social::_apply_interactions(user_map, day.interactions);
+            social::_persist_interactions(user_handler, persisted, user_map, persistence);
+            for (auto &[id, user]: user_map) {
+                working.insert_or_assign(id, user);
+            }
+
+            for (const auto &chunk: day.new_users) {
+                // UsersFabric first: UserModels references it
+                fabric_handler.batch_insert_users(chunk.fabric_entries);
+                user_handler.batch_insert_users(chunk.user_models);
+                for (const auto &user: chunk.user_models) {
+                    working.emplace(user.user_id, user);
+                }
+            }
+
+            // Everything is written back, dropping the set only costs reloads
+            if (working.size() > WORKING_SET_MAX) working.clear();
+
+            results.push_back(DayResult{
+                    .new_users = day.new_user_count,
+                    .new_friendships = new_friendships,
+                    .total_interactions = static_cast<uint32_t>(day.interactions.size()),
+                    .persistence = persistence
+            });
+        }
+
+        return results;
+    }
+
     fabric::UserProfile
     get_user_profile(uint32_t id, social::UserModelHandler &user_handler, FabricInfoHandler &fabric_handler) {
         const auto model = user_handler.get_user_profile_view(id);
@@ -8,9 +8,21 @@
 #include <sstream>
 #include <atomic>
 #include "../Utils/Fabric.hpp"
+#include "../Entities/UserVersions.hpp"
 
 namespace fabric {
 
+    /**
+     * @brief UsersFabric row count of the live FabricInfoHandler, stored on every change.
+     *
+     * For readers on other threads (metrics) that must not dereference the handler: set_db_connection
+     * may replace it under them.
+     */
+    inline std::atomic<uint32_t> &published_fabric_count() {
+        static std::atomic<uint32_t> count{0};
+        return count;
+    }
+
     class FabricInfoHandler {
     public:
         explicit FabricInfoHandler(MYSQL* db) : conn(db) {
@@ -18,6 +30,7 @@ namespace fabric {
                 throw std::runtime_error("MySQL connection is null");
             }
             update_count(); // Initialize count
+            social::user_versions().bump_all();
         }
 
         [[nodiscard]] UsersFabric load_user(uint64_t id) const {
@@ -98,6 +111,7 @@ namespace fabric {
                 throw std::runtime_error(mysql_stmt_error(stmt));
 
             mysql_stmt_close(stmt);
+            social::user_versions().bump(static_cast<uint32_t>(user.user_id));
             update_count(); // refresh count
         }
 
@@ -125,6 +139,8 @@ namespace fabric {
             if (mysql_query(conn, sql.str().c_str()) != 0)
                 throw std::runtime_error("Failed batch insert: " + std::string(mysql_error(conn)));
 
+            // INSERT IGNORE may have kept some rows, a spurious bump only costs one full response
+            for (const auto& user : users) social::user_versions().bump(static_cast<uint32_t>(user.user_id));
             update_count(); // refresh count
         }
 
@@ -138,7 +154,8 @@ namespace fabric {
             }
 
             mysql_query(conn, "SET FOREIGN_KEY_CHECKS = 1");
-            count = 0;
+            set_count(0);
+            social::user_versions().bump_all();
         }
 
         [[nodiscard]] uint32_t get_count() const noexcept {
@@ -198,9 +215,14 @@ namespace fabric {
                 throw std::runtime_error("Failed to fetch count row");
             }
 
-            count = static_cast<uint32_t>(std::stoul(row[0]));
+            set_count(static_cast<uint32_t>(std::stoul(row[0])));
             mysql_free_result(res);
         }
+
+        void set_count(const uint32_t n) {
+            count = n;
+            published_fabric_count().store(n, std::memory_order_relaxed);
+        }
     };
 
 } // namespace fabric
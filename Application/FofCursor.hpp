@@ -0,0 +1,203 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Business.hpp"
+#include "SearchArena.hpp"
+
+namespace social {
+
+    /**
+     * @brief recommend_A_star as a resumable search: each next() call yields the following page.
+     *
+     * Owns the whole search state (bucket queue, best costs, recommended set, cached profiles) instead of
+     * the thread's SearchArena, so it can be parked in a PaginationStore between requests. Pages
+     * concatenate to exactly the order recommend_A_star produces, and the first page of size N equals
+     * recommend_A_star<N>.
+     *
+     * A budget bounds one page, not the whole search: when it runs out the page ends early with
+     * stats->partial set and the cursor resumes at the same node next time, so no candidate is lost.
+     * A page whose loads throw leaves the cursor at the start of that page, ready to serve it again.
+     */
+    class FofCursor final {
+    public:
+        FofCursor(const UserModel &self, const uint8_t max_depth)
+                : self(self), max_depth(std::min<uint8_t>(max_depth, MAX_SEARCH_DEPTH)) {
+            push({self.user_id, 0, 0});
+            best.emplace(self.user_id, 0);
+        }
+
+        /// True once the search ran out of candidates; next() then returns nothing.
+        [[nodiscard]] bool exhausted() const { return done; }
+
+        /// Approximate heap footprint, for the byte budget of a PaginationStore.
+        [[nodiscard]] size_t memory_bytes() const {
+            // Hashed containers: one node per element plus one pointer per hash bucket
+            const auto hashed = [](const auto &c, const size_t element) {
+                return c.size() * (element + 2 * sizeof(void *)) + c.bucket_count() * sizeof(void *);
+            };
+            size_t bytes = sizeof(*this);
+            for (const auto &bucket: buckets) bytes += bucket.capacity() * sizeof(SearchArena::Node);
+            return bytes + hashed(best, sizeof(std::pair<const uint32_t, uint8_t>)) +
+                   hashed(recommended, sizeof(uint32_t)) +
+                   hashed(profiles, sizeof(std::pair<const uint32_t, SearchArena::Profile>));
+        }
+
+        /**
+         * @brief The next up to @p count recommendations.
+         * @tparam Source Same read interface as for recommend_A_star.
+         */
+        template<typename Source = UserModelHandler>
+        std::vector<uint32_t> next(const Source &ctrl, const size_t count, const SearchBudget &budget = {},
+                                   SearchStats *stats = nullptr) {
+            std::vector<uint32_t> page;
+            page.reserve(count);
+            SearchStats local{};
+
+            // Where this page starts; expansions made before a throw stay, re-expanding a node pushes nothing
+            const size_t start_cost = cost, start_index = index;
+            const bool start_sorted = sorted, start_pending = pending_expand, start_done = done;
+            try {
+                walk(ctrl, count, budget, page, local);
+            } catch (...) {
+                for (const uint32_t id: page) recommended.erase(id);
+                cost = start_cost;
+                index = start_index;
+                sorted = start_sorted;
+                pending_expand = start_pending;
+                done = start_done;
+                throw;
+            }
+
+            // Walked for good: give the memory of the finished buckets back
+            for (size_t c = start_cost; c < cost; ++c) std::vector<SearchArena::Node>().swap(buckets[c]);
+
+            if (stats) *stats = local;
+            return page;
+        }
+
+    private:
+        UserModel self;
+        uint8_t max_depth;
+
+        std::array<std::vector<SearchArena::Node>, SearchArena::BUCKETS> buckets;
+        size_t highest = 0;
+        size_t cost = 0;              /// bucket being walked
+        size_t index = 0;             /// next node in it
+        bool sorted = false;          /// buckets[cost] is in user_id order
+        bool pending_expand = false;  /// buckets[cost][index] was recommended, not yet expanded
+        bool done = false;
+
+        std::unordered_map<uint32_t, uint8_t> best;
+        std::unordered_set<uint32_t> recommended;
+        std::unordered_map<uint32_t, SearchArena::Profile> profiles;
+
+        template<typename Source>
+        void walk(const Source &ctrl, const size_t count, const SearchBudget &budget, std::vector<uint32_t> &page,
+                  SearchStats &local) {
+            while (page.size() < count && seek()) {
+                const SearchArena::Node current = buckets[cost][index];
+
+                if (!pending_expand) {
+                    if (current.user_id != self.user_id && recommended.insert(current.user_id).second &&
+                        !social::is_friend(self, current.user_id)) {
+                        page.push_back(current.user_id);
+                    }
+                    pending_expand = true;
+                    if (page.size() == count) break; // expand it on the next page
+                }
+
+                if (current.depth < max_depth) {
+                    // Out of budget: end the page, at least one node per page keeps clients moving
+                    if (local.expansions > 0 && (local.expansions >= budget.max_expansions ||
+                                                 std::chrono::steady_clock::now() >= budget.deadline)) {
+                        local.partial = true;
+                        break;
+                    }
+                    ++local.expansions;
+                    expand(ctrl, current, local);
+                }
+
+                pending_expand = false;
+                ++index;
+            }
+            seek(); // a page ending on the last candidate already reports exhausted()
+        }
+
+        void push(const SearchArena::Node node) {
+            buckets[node.cost].push_back(node);
+            highest = std::max<size_t>(highest, node.cost);
+        }
+
+        /// Move to the next node to visit, @return false once every bucket is walked.
+        bool seek() {
+            while (cost <= highest) {
+                auto &bucket = buckets[cost];
+                if (!sorted) {
+                    // Edge costs are >= 1, nothing is pushed into this bucket while it is walked
+                    std::sort(bucket.begin(), bucket.end(), [](const SearchArena::Node &a, const SearchArena::Node &b) {
+                        return a.user_id < b.user_id;
+                    });
+                    sorted = true;
+                }
+                if (index < bucket.size()) return true;
+
+                ++cost; // next() frees the walked buckets once its page succeeded
+                index = 0;
+                sorted = false;
+            }
+            done = true;
+            return false;
+        }
+
+        template<typename Source>
+        void expand(const Source &ctrl, const SearchArena::Node current, SearchStats &local) {
+            const auto &node = ctrl.load_user_by_id(current.user_id);
+            ++local.db_calls;
+
+            for (const auto &[fid, _]: node.friends) {
+                if (fid == INVALID_FRIEND_ID || profiles.contains(fid)) continue;
+                const auto view = ctrl.get_user_profile_view(fid);
+                profiles.emplace(fid, SearchArena::Profile{view.interests_16, view.base_64_bits});
+                ++local.db_calls;
+            }
+
+            for (const auto &[fid, _]: node.friends) {
+                if (fid == INVALID_FRIEND_ID || fid == self.user_id) continue;
+
+                const auto &prof = profiles.at(fid);
+                const auto new_cost = static_cast<uint8_t>(current.cost +
+                                                           _fof_edge_cost(self, prof.interests_16, prof.base_64_bits));
+                const auto [it, first] = best.try_emplace(fid, new_cost);
+                if (first || new_cost < it->second) {
+                    it->second = new_cost;
+                    push({fid, new_cost, static_cast<uint8_t>(current.depth + 1)});
+                }
+            }
+        }
+    };
+
+    /// A ranking computed once and handed out page by page (recommend_strangers pagination).
+    struct RankedPool {
+        std::vector<uint32_t> ids;
+        size_t offset = 0;
+
+        [[nodiscard]] bool exhausted() const { return offset >= ids.size(); }
+
+        [[nodiscard]] size_t memory_bytes() const { return sizeof(*this) + ids.capacity() * sizeof(uint32_t); }
+
+        std::vector<uint32_t> next(const size_t count) {
+            const size_t end = std::min(ids.size(), offset + count);
+            std::vector<uint32_t> page(ids.begin() + static_cast<std::ptrdiff_t>(offset),
+                                       ids.begin() + static_cast<std::ptrdiff_t>(end));
+            offset = end;
+            return page;
+        }
+    };
+
+}
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "Business.hpp"
+
+namespace social {
+
+    static_assert(sizeof(InteractionEntry) == 3 * sizeof(uint32_t), "packed ingest format is 3 x u32");
+
+    /// Largest score one ingested interaction may add to a friendship (simulated days draw 1..30).
+    constexpr uint32_t INGEST_SCORE_MAX = 1000;
+
+    /// Outcome of parsing one ingest body.
+    JH_POD_STRUCT(IngestParse,
+                  uint32_t accepted;
+                          uint32_t skipped; /// self-interactions and zero ids, dropped on purpose
+                          uint32_t error_line; /// 0 = ok, else the 1-based NDJSON line or binary record (1 for a bad binary size)
+                          bool bad_score; /// the error is a score of 0 or above INGEST_SCORE_MAX
+    );
+
+    /// Scores outside 1..INGEST_SCORE_MAX reject the whole body: 0 would make an empty friend slot.
+    inline bool _is_valid_score(const uint32_t score) noexcept {
+        return score != 0 && score <= INGEST_SCORE_MAX;
+    }
+
+    /// Interactions referencing user id 0 or the same user twice never reach the updater.
+    inline bool _is_ingestable(const InteractionEntry &entry) noexcept {
+        return entry.user1_id != 0 && entry.user2_id != 0 && entry.user1_id != entry.user2_id;
+    }
+
+    /**
+     * @brief Parse NDJSON interactions without building a DOM.
+     *
+     * One object per line, keys in any order, unsigned integer values only:
+     * @code
+     * {"user1_id": 12, "user2_id": 40, "score": 3}
+     * @endcode
+     * Blank lines are ignored. Any other shape stops the parse and reports its line.
+     */
+    inline IngestParse parse_interactions_ndjson(std::string_view body, interaction_input &out) {
+        IngestParse result{};
+        uint32_t line_no = 0;
+
+        while (!body.empty()) {
+            const size_t eol = body.find('\n');
+            std::string_view line = body.substr(0, eol);
+            body.remove_prefix(eol == std::string_view::npos ? body.size() : eol + 1);
+            ++line_no;
+
+            const auto skip_ws = [&line] {
+                while (!line.empty() && (line.front() == ' ' || line.front() == '\t' || line.front() == '\r')) {
+                    line.remove_prefix(1);
+                }
+            };
+            const auto expect = [&](const char c) {
+                skip_ws();
+                if (line.empty() || line.front() != c) return false;
+                line.remove_prefix(1);
+                return true;
+            };
+
+            skip_ws();
+            if (line.empty()) continue;
+
+            InteractionEntry entry{};
+            uint32_t seen = 0; // bit per key
+            bool ok = expect('{');
+            while (ok) {
+                // "key"
+                ok = expect('"');
+                if (!ok) break;
+                const size_t quote = line.find('"');
+                if (quote == std::string_view::npos) {
+                    ok = false;
+                    break;
+                }
+                const std::string_view key = line.substr(0, quote);
+                line.remove_prefix(quote + 1);
+
+                // : number
+                ok = expect(':');
+                if (!ok) break;
+                skip_ws();
+                uint32_t value = 0;
+                const auto [ptr, ec] = std::from_chars(line.data(), line.data() + line.size(), value);
+                if (ec != std::errc{}) {
+                    ok = false;
+                    break;
+                }
+                line.remove_prefix(static_cast<size_t>(ptr - line.data()));
+
+                if (key == "user1_id") {
+                    entry.user1_id = value;
+                    seen |= 1;
+                } else if (key == "user2_id") {
+                    entry.user2_id = value;
+                    seen |= 2;
+                } else if (key == "score") {
+                    entry.score = value;
+                    seen |= 4;
+                } else {
+                    ok = false;
+                    break;
+                }
+
+                // , or }
+                if (expect('}')) break;
+                ok = expect(',');
+            }
+
+            skip_ws();
+            if (!ok || seen != 7 || !line.empty()) {
+                result.error_line = line_no;
+                return result;
+            }
+            if (!_is_valid_score(entry.score)) {
+                result.error_line = line_no;
+                result.bad_score = true;
+                return result;
+            }
+
+            if (_is_ingestable(entry)) {
+                out.push_back(entry);
+                ++result.accepted;
+            } else {
+                ++result.skipped;
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @brief Parse a raw body of packed InteractionEntry records (user1_id, user2_id, score).
+     *
+     * The wire format is little-endian whatever the host: copied as is on little-endian hosts,
+     * byte-swapped field by field on big-endian ones.
+     */
+    inline IngestParse parse_interactions_packed(const std::string_view body, interaction_input &out) {
+        const auto from_le = [](uint32_t v) {
+            if constexpr (std::endian::native == std::endian::big) {
+                v = (v >> 24) | ((v >> 8) & 0xFF00u) | ((v << 8) & 0xFF0000u) | (v << 24);
+            }
+            return v;
+        };
+
+        IngestParse result{};
+        if (body.size() % sizeof(InteractionEntry) != 0) {
+            result.error_line = 1;
+            return result;
+        }
+
+        const size_t count = body.size() / sizeof(InteractionEntry);
+        out.reserve(out.size() + count);
+        for (size_t i = 0; i < count; ++i) {
+            InteractionEntry entry{};
+            std::memcpy(&entry, body.data() + i * sizeof(InteractionEntry), sizeof(InteractionEntry));
+            if constexpr (std::endian::native == std::endian::big) {
+                entry.user1_id = from_le(entry.user1_id);
+                entry.user2_id = from_le(entry.user2_id);
+                entry.score = from_le(entry.score);
+            }
+            if (!_is_valid_score(entry.score)) {
+                result.error_line = static_cast<uint32_t>(i + 1);
+                result.bad_score = true;
+                return result;
+            }
+            if (_is_ingestable(entry)) {
+                out.push_back(entry);
+                ++result.accepted;
+            } else {
+                ++result.skipped;
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @brief Bounded queue of interaction batches, drained by one background thread.
+     *
+     * Producers never block: try_push() refuses a batch that would exceed the capacity, which is the
+     * caller's cue to answer 429. The drain thread merges whatever is queued (up to DRAIN_MAX) into a
+     * single call of the sink, so a burst of small requests still becomes one _batch_update_interactions.
+     * A merged batch the sink throws on is lost (it was already answered 202); dropped() counts it.
+     */
+    class IngestQueue final {
+    public:
+        /// Interactions held at most (12 bytes each).
+        static constexpr size_t CAPACITY = size_t{1} << 20;
+        /// Interactions handed to the sink per call.
+        static constexpr size_t DRAIN_MAX = size_t{1} << 16;
+
+        using Sink = std::function<void(const interaction_input &)>;
+
+        IngestQueue() = default;
+
+        IngestQueue(const IngestQueue &) = delete;
+
+        IngestQueue &operator=(const IngestQueue &) = delete;
+
+        ~IngestQueue() {
+            stop();
+        }
+
+        /// Start the drain thread; a running queue is stopped first.
+        void start(Sink on_batch) {
+            stop();
+            {
+                std::lock_guard lock(mut);
+                sink = std::move(on_batch);
+                stopping = false;
+            }
+            worker = std::thread([this] { drain_loop(); });
+        }
+
+        /// Drain what is already queued, then join the drain thread.
+        void stop() {
+            {
+                std::lock_guard lock(mut);
+                stopping = true;
+            }
+            ready.notify_all();
+            if (worker.joinable()) worker.join();
+        }
+
+        /// @return false (and leaves @p batch untouched) if it does not fit or the queue is not running.
+        bool try_push(interaction_input &&batch) {
+            {
+                std::lock_guard lock(mut);
+                if (stopping || queued + batch.size() > CAPACITY) return false;
+                queued += batch.size();
+                batches.push_back(std::move(batch));
+            }
+            ready.notify_one();
+            return true;
+        }
+
+        /// Interactions waiting, not counting the batch currently being applied.
+        [[nodiscard]] size_t depth() const {
+            std::lock_guard lock(mut);
+            return queued;
+        }
+
+        /// Accepted interactions lost because the sink threw, since the process started.
+        [[nodiscard]] uint64_t dropped() const noexcept {
+            return dropped_total.load(std::memory_order_relaxed);
+        }
+
+    private:
+        mutable std::mutex mut;
+        std::condition_variable ready;
+        std::deque<interaction_input> batches;
+        size_t queued = 0;
+        bool stopping = true; /// also true before the first start()
+        Sink sink;
+        std::thread worker;
+        std::atomic<uint64_t> dropped_total{0};
+
+        void drain_loop() {
+            interaction_input merged;
+            for (;;) {
+                {
+                    std::unique_lock lock(mut);
+                    ready.wait(lock, [this] { return stopping || !batches.empty(); });
+                    if (batches.empty()) return; // stopping and drained
+
+                    merged.clear();
+                    while (!batches.empty() && (merged.empty() || merged.size() + batches.front().size() <= DRAIN_MAX)) {
+                        auto &front = batches.front();
+                        merged.insert(merged.end(), front.begin(), front.end());
+                        queued -= front.size();
+                        batches.pop_front();
+                    }
+                }
+
+                try {
+                    sink(merged);
+                } catch (const std::exception &e) {
+                    dropped_total.fetch_add(merged.size(), std::memory_order_relaxed);
+                    std::cerr << "[Ingest] dropped " << merged.size() << " interactions: " << e.what() << std::endl;
+                }
+            }
+        }
+    };
+
+}
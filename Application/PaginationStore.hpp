@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+namespace social {
+
+    /**
+     * @brief Bounded, expiring server-side store of pagination states behind opaque tokens.
+     *
+     * Tokens are 128 random bits in hex, drawn from std::random_device so one client cannot guess
+     * another's cursor. A token is single-use: take() removes its state, and the caller put()s the
+     * advanced state back under a fresh token for the next page. Two requests racing on one token
+     * therefore never continue the same state twice; the loser just sees an unknown token.
+     *
+     * Bounded by entry count and by bytes, as reported by State::memory_bytes(). Once either is
+     * reached, put() first drops expired states and then the ones closest to expiring. A state
+     * larger than the whole byte budget is refused.
+     */
+    template<typename State>
+    class PaginationStore final {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        PaginationStore(const size_t capacity, const size_t max_bytes, const clock::duration ttl)
+                : capacity(capacity), max_bytes(max_bytes), ttl(ttl) {}
+
+        PaginationStore(const PaginationStore &) = delete;
+
+        PaginationStore &operator=(const PaginationStore &) = delete;
+
+        /// Store @p state, @return the token to continue it with, nullopt if it alone exceeds the byte budget.
+        std::optional<std::string> put(State &&state) {
+            const size_t size = state.memory_bytes();
+            if (size > max_bytes) return std::nullopt;
+
+            std::lock_guard lock(mut);
+            std::string token = new_token();
+            while (entries.contains(token)) token = new_token();
+            insert(token, std::move(state), size);
+            return token;
+        }
+
+        /**
+         * @brief Store again a state take()n from @p token that could not be advanced, so the same token
+         * can be retried. The state counts as a fresh one (full TTL, may evict others).
+         */
+        void put_back(const std::string &token, State &&state) {
+            const size_t size = state.memory_bytes();
+            if (size > max_bytes) return;
+
+            std::lock_guard lock(mut);
+            if (!entries.contains(token)) insert(token, std::move(state), size);
+        }
+
+        /// Remove and @return the state of @p token, nullopt if unknown or expired.
+        std::optional<State> take(const std::string &token) {
+            std::lock_guard lock(mut);
+            const auto it = entries.find(token);
+            if (it == entries.end()) return std::nullopt;
+
+            std::optional<State> state;
+            if (it->second.expires > clock::now()) state.emplace(std::move(it->second.state));
+            erase(it);
+            return state;
+        }
+
+        /// Forget every state, e.g. after the population was regenerated.
+        void clear() {
+            std::lock_guard lock(mut);
+            entries.clear();
+            total_bytes = 0;
+        }
+
+        [[nodiscard]] size_t size() const {
+            std::lock_guard lock(mut);
+            return entries.size();
+        }
+
+        /// Sum of memory_bytes() of the stored states.
+        [[nodiscard]] size_t bytes() const {
+            std::lock_guard lock(mut);
+            return total_bytes;
+        }
+
+    private:
+        struct Entry {
+            State state;
+            clock::time_point expires;
+            size_t bytes;
+        };
+
+        const size_t capacity;
+        const size_t max_bytes;
+        const clock::duration ttl;
+
+        mutable std::mutex mut;
+        std::unordered_map<std::string, Entry> entries;
+        size_t total_bytes = 0;
+        std::random_device entropy;
+
+        /// Requires mut held.
+        void insert(const std::string &token, State &&state, const size_t size) {
+            const auto now = clock::now();
+            evict(now, size);
+            entries.emplace(token, Entry{std::move(state), now + ttl, size});
+            total_bytes += size;
+        }
+
+        /// Requires mut held.
+        void erase(const typename std::unordered_map<std::string, Entry>::iterator it) {
+            total_bytes -= it->second.bytes;
+            entries.erase(it);
+        }
+
+        /// Requires mut held. Make room for one more state of @p incoming bytes.
+        void evict(const clock::time_point now, const size_t incoming) {
+            const auto full = [&] { return entries.size() >= capacity || total_bytes + incoming > max_bytes; };
+            if (!full()) return;
+
+            for (auto it = entries.begin(); it != entries.end();) {
+                if (it->second.expires <= now) {
+                    total_bytes -= it->second.bytes;
+                    it = entries.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            while (full() && !entries.empty()) {
+                auto oldest = entries.begin();
+                for (auto it = entries.begin(); it != entries.end(); ++it) {
+                    if (it->second.expires < oldest->second.expires) oldest = it;
+                }
+                erase(oldest);
+            }
+        }
+
+        /// Requires mut held.
+        std::string new_token() {
+            static constexpr char HEX[] = "0123456789abcdef";
+            std::string token(32, '0');
+            for (size_t i = 0; i < token.size(); i += 8) {
+                uint32_t word = entropy();
+                for (size_t j = 0; j < 8; ++j, word >>= 4) token[i + j] = HEX[word & 0xF];
+            }
+            return token;
+        }
+    };
+
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <vector>
+#include "UserModelHandler.hpp"
+
+namespace social {
+
+    /**
+     * @brief Reusable per-thread state of one FoF search: a Dial bucket queue plus dense per-user slots.
+     *
+     * Path costs are uint8_t, so the open set is 256 buckets indexed by cost instead of a binary heap.
+     * Per-user state (best cost, recommended, cached profile) lives in arrays indexed by user id and
+     * stamped with the search epoch: starting a search is one increment, not a clear of every slot.
+     * Buffers keep their capacity between searches, a warm search allocates nothing.
+     *
+     * One search per thread at a time; get it through search_arena().
+     */
+    class SearchArena final {
+    public:
+        struct Node {
+            uint32_t user_id;
+            uint8_t cost;
+            uint8_t depth;
+        };
+
+        /// The two profile columns a search scores with.
+        struct Profile {
+            uint64_t interests_16;
+            uint64_t base_64_bits;
+        };
+
+        static constexpr size_t BUCKETS = 256;
+
+        /// Start a new search: every slot reads as unvisited, every bucket is empty.
+        void begin() {
+            for (size_t c = lowest; c <= highest && c < BUCKETS; ++c) buckets[c].clear();
+            lowest = BUCKETS;
+            highest = 0;
+
+            if (++epoch == 0) {
+                // stamps wrapped around, a stale slot could now look current
+                std::fill(visit_stamp.begin(), visit_stamp.end(), 0);
+                std::fill(profile_stamp.begin(), profile_stamp.end(), 0);
+                epoch = 1;
+            }
+        }
+
+        void push(const Node node) {
+            buckets[node.cost].push_back(node);
+            lowest = std::min<size_t>(lowest, node.cost);
+            highest = std::max<size_t>(highest, node.cost);
+        }
+
+        /// Bucket of cost @p c; callers walk costs upwards, pushes only ever land in higher buckets.
+        std::vector<Node> &bucket(const size_t c) { return buckets[c]; }
+
+        [[nodiscard]] size_t highest_cost() const { return highest; }
+
+        /// True once @p id got a cost in this search.
+        [[nodiscard]] bool reached(const uint32_t id) const {
+            return id < visit_stamp.size() && visit_stamp[id] == epoch;
+        }
+
+        [[nodiscard]] uint8_t best_cost(const uint32_t id) const { return best[id]; }
+
+        void set_best_cost(const uint32_t id, const uint8_t cost) {
+            reserve(id);
+            if (visit_stamp[id] != epoch) {
+                visit_stamp[id] = epoch;
+                recommended[id] = 0;
+            }
+            best[id] = cost;
+        }
+
+        /// Only valid for reached ids.
+        [[nodiscard]] bool is_recommended(const uint32_t id) const { return recommended[id] != 0; }
+
+        void mark_recommended(const uint32_t id) { recommended[id] = 1; }
+
+        [[nodiscard]] bool has_profile(const uint32_t id) const {
+            return id < profile_stamp.size() && profile_stamp[id] == epoch;
+        }
+
+        [[nodiscard]] const Profile &profile(const uint32_t id) const { return profiles[id]; }
+
+        void set_profile(const uint32_t id, const UserProfileView &view) {
+            reserve(id);
+            profile_stamp[id] = epoch;
+            profiles[id] = {view.interests_16, view.base_64_bits};
+        }
+
+    private:
+        uint32_t epoch = 0;
+        std::array<std::vector<Node>, BUCKETS> buckets;
+        size_t lowest = 0;
+        size_t highest = BUCKETS - 1; // first begin() clears everything
+
+        std::vector<uint32_t> visit_stamp;   /// by user id, == epoch if best / recommended are current
+        std::vector<uint8_t> best;           /// by user id
+        std::vector<uint8_t> recommended;    /// by user id
+        std::vector<uint32_t> profile_stamp; /// by user id, == epoch if profiles is current
+        std::vector<Profile> profiles;       /// by user id
+
+        void reserve(const uint32_t id) {
+            if (id < visit_stamp.size()) return;
+            // grow geometrically, ids arrive in any order
+            const size_t size = std::max<size_t>(static_cast<size_t>(id) + 1, visit_stamp.size() * 2);
+            visit_stamp.resize(size, 0);
+            best.resize(size, 0);
+            recommended.resize(size, 0);
+            profile_stamp.resize(size, 0);
+            profiles.resize(size);
+        }
+    };
+
+    /// This thread's SearchArena.
+    inline SearchArena &search_arena() {
+        thread_local SearchArena arena;
+        return arena;
+    }
+
+}
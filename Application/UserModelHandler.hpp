@@ -4,9 +4,15 @@
 #include <string>
 #include <stdexcept>
 #include <sstream>
+#include <charconv>
+#include <mutex>
 #include <unordered_set>
 #include <unordered_map>
 #include "../Entities/UserModel.hpp"
+#include "../Entities/HammingIndex.hpp"
+#include "../Entities/ProfileColumns.hpp"
+#include "../Entities/CommonFriends.hpp"
+#include "../Entities/UserVersions.hpp"
 
 using interaction_batch = pod::array<pod::pair<uint32_t, uint32_t>, 256>;
 
@@ -20,6 +26,47 @@ namespace social {
     class UserModelHandler {
     public:
         explicit UserModelHandler(MYSQL *db) : conn(db) {
+            load_profile_mirrors();
+            user_versions().bump_all(); // possibly another database, no earlier version holds
+        }
+
+        /// In-memory mirror of every user's base_64_bits, fed by profile_columns().
+        [[nodiscard]] const HammingIndex &basics_index() const noexcept {
+            return columns.basics_index();
+        }
+
+        /// In-memory SoA mirror of every user's interests_16 / base_64_bits, kept in sync by all write paths.
+        [[nodiscard]] const ProfileColumns &profile_columns() const noexcept {
+            return columns;
+        }
+
+        /// Per-user common-friend tables, updated by every friendship change that goes through this handler.
+        [[nodiscard]] CommonFriendIndex &common_friends() const noexcept {
+            return common;
+        }
+
+        /**
+         * @brief The common-friend table of @p self, counted from the database when not cached.
+         *
+         * Counts every friend of every friend once and keeps the TABLE_SIZE largest counts. The table
+         * stays cached until a write changes the list of @p self or of one of its friends.
+         */
+        [[nodiscard]] CommonFriendTable common_friend_table(const UserModel &self) const {
+            if (auto table = common.find(self.user_id)) return *table;
+
+            // Versions first, lists second: see CommonFriendIndex::put
+            std::vector<UserVersions::Version> seen{user_versions().get(self.user_id)};
+            const UserModel owner = load_user_by_id(self.user_id);
+            const std::vector<uint32_t> reads = CommonFriendIndex::reads_of(owner);
+            for (size_t i = 1; i < reads.size(); ++i) seen.push_back(user_versions().get(reads[i]));
+
+            std::vector<UserModel> friends;
+            friends.reserve(reads.size() - 1);
+            for (auto &[_, f]: batch_load_users_by_ids({reads.begin() + 1, reads.end()})) friends.push_back(f);
+
+            const CommonFriendTable table = count_common_friends(owner, friends);
+            common.put(owner, table, seen);
+            return table;
         }
 
         /// Load user from db
@@ -130,6 +177,8 @@ namespace social {
                 throw std::runtime_error(mysql_stmt_error(stmt));
 
             mysql_stmt_close(stmt);
+            columns.set_interests(user_id, new_val);
+            user_versions().bump(user_id);
         }
 
         /// Check if two UserModels are friends
@@ -187,6 +236,8 @@ namespace social {
                 throw std::runtime_error(mysql_stmt_error(stmt));
 
             mysql_stmt_close(stmt);
+            columns.set(id, interests_16, base_64_bits);
+            user_versions().bump(id);
         }
 
         [[maybe_unused]] void update_base_64_bits(uint32_t user_id, uint64_t new_val) const {
@@ -215,6 +266,8 @@ namespace social {
                 throw std::runtime_error(mysql_stmt_error(stmt));
 
             mysql_stmt_close(stmt);
+            columns.set_bits(user_id, new_val);
+            user_versions().bump(user_id);
         }
 
         /// Batch load users by IDs
@@ -345,8 +398,9 @@ namespace social {
             std::lock_guard lock(mut);
 
             UserModel user = load_user_by_id(user_id);
+            const UserModel before = user;
             social::add_interaction(user, target_id, amount);
-            save_user(user);
+            save_with_common({{&before, &user}}); // a new target fills a free slot
             return true;
         }
 
@@ -354,12 +408,13 @@ namespace social {
             std::lock_guard lock(mut);
 
             UserModel user = load_user_by_id(user_id);
+            const UserModel before = user;
             for (const auto &[fid, amt]: interactions) {
                 if (fid != INVALID_FRIEND_ID && amt > 0) {
                     social::add_interaction(user, fid, amt);
                 }
             }
-            save_user(user);
+            save_with_common({{&before, &user}});
             return true;
         }
 
@@ -367,8 +422,9 @@ namespace social {
             std::lock_guard lock(mut);
 
             UserModel u1 = load_user_by_id(id1);
+            const UserModel before = u1;
             if (!social::add_friend(u1, id2, score)) return false;
-            save_user(u1);
+            save_with_common({{&before, &u1}});
             return true;
         }
 
@@ -376,8 +432,9 @@ namespace social {
             std::lock_guard lock(mut);
 
             UserModel u1 = load_user_by_id(id1);
+            const UserModel before = u1;
             if (!social::remove_friend(u1, id2)) return false;
-            save_user(u1);
+            save_with_common({{&before, &u1}});
             return true;
         }
 
@@ -385,8 +442,9 @@ namespace social {
             std::lock_guard lock(mut);
 
             UserModel u1 = load_user_by_id(id1);
+            const UserModel before = u1;
             social::decay_interactions(u1, rate);
-            save_user(u1);
+            save_with_common({{&before, &u1}}); // slots decayed to 0 are dropped
         }
 
         static std::string build_interest_similarity_sql(const uint32_t user_id,
@@ -434,54 +492,201 @@ namespace social {
             return result;
         }
 
-        static inline std::string hex_encode(const std::byte *data, size_t len) {
+        static inline void append_hex(std::string &out, const std::byte *data, size_t len) {
             static constexpr char hex[] = "0123456789ABCDEF";
-            std::vector<char> buf;
-            buf.reserve(len * 2);  // Pre-allocate exact space
+            const size_t pos = out.size();
+            out.resize(pos + len * 2);
 
+            char *dst = out.data() + pos;
             for (size_t i = 0; i < len; ++i) {
                 auto byte = static_cast<uint8_t>(data[i]);
-                buf.emplace_back(hex[byte >> 4]);
-                buf.emplace_back(hex[byte & 0x0F]);
+                *dst++ = hex[byte >> 4];
+                *dst++ = hex[byte & 0x0F];
             }
-            return {buf.data(), buf.size()}; // Construct string from vector
+        }
+
+        static inline std::string hex_encode(const std::byte *data, size_t len) {
+            std::string out;
+            append_hex(out, data, len);
+            return out;
+        }
+
+        static inline void append_number(std::string &out, const uint64_t value) {
+            char buf[20];
+            const auto [end, _] = std::to_chars(buf, buf + sizeof(buf), value);
+            out.append(buf, end);
         }
 
         void batch_insert_users(const std::vector<UserModel> &users) const {
             if (users.empty()) return;
             std::lock_guard lock(mut);
 
-            std::ostringstream sql;
-            sql << "INSERT INTO UserModels (user_id, interests_16, base_64_bits, friends) VALUES ";
+            // Never committed: ON DUPLICATE KEY may replace lists, so the tables around every row are dropped
+            std::vector<uint32_t> ids;
+            ids.reserve(users.size());
+            for (const auto &user: users) ids.push_back(user.user_id);
+            [[maybe_unused]] const auto write = common.begin_write(std::move(ids));
+
+            // Each row carries ~4 KiB of hex, build the whole statement in one pre-sized buffer
+            std::string query;
+            query.reserve(256 + users.size() * (2 * sizeof(friend_list) + 80));
+            query += "INSERT INTO UserModels (user_id, interests_16, base_64_bits, friends) VALUES ";
 
             bool first = true;
             for (const auto &user: users) {
                 const auto view = jh::pod::bytes_view::from(user.friends);
-                const std::string hex_blob = hex_encode(view.data, view.len); // safe BLOB to hex
 
                 if (!first) {
-                    sql << ", ";
+                    query += ", ";
                 } else {
                     first = false;
                 }
 
-                sql << "("
-                    << user.user_id << ", "
-                    << user.interests_16 << ", "
-                    << user.base_64_bits << ", "
-                    << "UNHEX('" << hex_blob << "'))";
+                query += '(';
+                append_number(query, user.user_id);
+                query += ", ";
+                append_number(query, user.interests_16);
+                query += ", ";
+                append_number(query, user.base_64_bits);
+                query += ", UNHEX('";
+                append_hex(query, view.data, view.len); // safe BLOB to hex
+                query += "'))";
             }
 
             // Optional: use ON DUPLICATE to update existing user
-            sql << " ON DUPLICATE KEY UPDATE "
-                << "interests_16=VALUES(interests_16), "
-                << "base_64_bits=VALUES(base_64_bits), "
-                << "friends=VALUES(friends)";
+            query += " ON DUPLICATE KEY UPDATE "
+                     "interests_16=VALUES(interests_16), "
+                     "base_64_bits=VALUES(base_64_bits), "
+                     "friends=VALUES(friends)";
 
-            const std::string query = sql.str();
-            if (mysql_query(conn, query.c_str()) != 0) {
+            if (mysql_real_query(conn, query.data(), query.size()) != 0) {
                 throw std::runtime_error(std::string("Failed batch insert: ") + mysql_error(conn));
             }
+
+            for (const auto &user: users) {
+                columns.set(user.user_id, user.interests_16, user.base_64_bits);
+                user_versions().bump(user.user_id);
+            }
+        }
+
+        /**
+         * @brief Build one UPDATE that writes only the dirty parts of @p rows.
+         *
+         * Runs of dirty friend slots are patched in place with INSERT(friends, pos, len, X'..'),
+         * clean slots are never sent. interests_16 / base_64_bits are only set for rows flagged dirty.
+         */
+        static std::string build_dirty_update_sql(const std::vector<DirtyUser> &rows) {
+            constexpr size_t slot_bytes = sizeof(friend_list) / friend_list::size();
+            constexpr size_t merge_gap = 4; // clean slots cheaper to resend than to open another INSERT()
+
+            bool any_friends = false, any_interests = false, any_bits = false;
+            for (const auto &[user, mask]: rows) {
+                any_friends |= mask.any_slot();
+                any_interests |= mask.interests;
+                any_bits |= mask.bits;
+            }
+
+            std::string query;
+            query.reserve(128 + rows.size() * 96);
+            query += "UPDATE UserModels SET ";
+
+            bool first_column = true;
+            const auto open_column = [&](const char *column) {
+                if (!first_column) query += ", ";
+                first_column = false;
+                query += column;
+                query += " = CASE user_id";
+            };
+
+            if (any_friends) {
+                open_column("friends");
+
+                std::vector<std::pair<size_t, size_t>> runs; // [first, last] slot
+                for (const auto &[user, mask]: rows) {
+                    if (!mask.any_slot()) continue;
+
+                    runs.clear();
+                    for (size_t i = 0; i < friend_list::size(); ++i) {
+                        if (!mask.slot(i)) continue;
+                        if (!runs.empty() && i - runs.back().second <= merge_gap + 1) {
+                            runs.back().second = i;
+                        } else {
+                            runs.emplace_back(i, i);
+                        }
+                    }
+
+                    const auto view = jh::pod::bytes_view::from(user->friends);
+                    query += " WHEN ";
+                    append_number(query, user->user_id);
+                    query += " THEN ";
+                    for (size_t r = 0; r < runs.size(); ++r) query += "INSERT(";
+                    query += "friends";
+                    for (const auto &[lo, hi]: runs) {
+                        const size_t len = (hi - lo + 1) * slot_bytes;
+                        query += ", ";
+                        append_number(query, lo * slot_bytes + 1);
+                        query += ", ";
+                        append_number(query, len);
+                        query += ", X'";
+                        append_hex(query, view.data + lo * slot_bytes, len);
+                        query += "')";
+                    }
+                }
+                query += " ELSE friends END";
+            }
+
+            if (any_interests) {
+                open_column("interests_16");
+                for (const auto &[user, mask]: rows) {
+                    if (!mask.interests) continue;
+                    query += " WHEN ";
+                    append_number(query, user->user_id);
+                    query += " THEN ";
+                    append_number(query, user->interests_16);
+                }
+                query += " ELSE interests_16 END";
+            }
+
+            if (any_bits) {
+                open_column("base_64_bits");
+                for (const auto &[user, mask]: rows) {
+                    if (!mask.bits) continue;
+                    query += " WHEN ";
+                    append_number(query, user->user_id);
+                    query += " THEN ";
+                    append_number(query, user->base_64_bits);
+                }
+                query += " ELSE base_64_bits END";
+            }
+
+            query += " WHERE user_id IN (";
+            bool first = true;
+            for (const auto &[user, _]: rows) {
+                if (!first) query += ',';
+                first = false;
+                append_number(query, user->user_id);
+            }
+            query += ')';
+
+            return query;
+        }
+
+        /// Persist the dirty parts of @p rows, returns the number of bytes sent to the server.
+        size_t batch_update_dirty(const std::vector<DirtyUser> &rows) const {
+            if (rows.empty()) return 0;
+            const std::string query = build_dirty_update_sql(rows);
+
+            std::lock_guard lock(mut);
+            if (mysql_real_query(conn, query.data(), query.size()) != 0) {
+                throw std::runtime_error(std::string("Failed dirty update: ") + mysql_error(conn));
+            }
+
+            for (const auto &[user, mask]: rows) {
+                if (mask.bits) columns.set_bits(user->user_id, user->base_64_bits);
+                if (mask.interests) columns.set_interests(user->user_id, user->interests_16);
+                user_versions().bump(user->user_id);
+            }
+            return query.size();
         }
 
         void clear_user_table() const {
@@ -490,6 +695,9 @@ namespace social {
             if (mysql_query(conn, query.c_str()) != 0) {
                 throw std::runtime_error("Failed to clear UserModels: " + std::string(mysql_error(conn)));
             }
+            columns.clear();
+            common.clear();
+            user_versions().bump_all();
         }
 
 
@@ -499,12 +707,12 @@ namespace social {
         bool add_friend_pair(const uint32_t id1, const uint32_t id2) {
             std::lock_guard lock(mut);
 
-            User u1 = load_user_by_id(id1);
-            User u2 = load_user_by_id(id2);
+            UserModel u1 = load_user_by_id(id1);
+            UserModel u2 = load_user_by_id(id2);
+            const UserModel b1 = u1, b2 = u2;
 
             if (!add_friend_mutual(u1, u2)) return false;
-            save_user(u1);
-            save_user(u2);
+            save_with_common({{&b1, &u1}, {&b2, &u2}});
             return true;
         }
 
@@ -512,13 +720,13 @@ namespace social {
         bool remove_friend_pair(const uint32_t id1, const uint32_t id2) {
             std::lock_guard lock(mut);
 
-            User u1 = load_user_by_id(id1);
-            User u2 = load_user_by_id(id2);
+            UserModel u1 = load_user_by_id(id1);
+            UserModel u2 = load_user_by_id(id2);
+            const UserModel b1 = u1, b2 = u2;
 
             if (!remove_friend_mutual(u1, u2)) return false;
 
-            save_user(u1);
-            save_user(u2);
+            save_with_common({{&b1, &u1}, {&b2, &u2}});
             return true;
         }
 
@@ -529,6 +737,29 @@ namespace social {
             if (mysql_query(conn, query.c_str()) != 0) {
                 throw std::runtime_error(std::string("Failed to clear users: ") + mysql_error(conn));
             }
+            user_versions().bump_all();
+            common.clear();
+        }
+
+        /**
+         * @brief Recount every cached common-friend table from the database and check its bounds.
+         * Meaningful while no other write is in flight, e.g. at the end of a simulated batch.
+         * @throws std::runtime_error naming the first owner whose table breaks the Space-Saving invariants.
+         */
+        void verify_common_friends() const {
+            for (const uint32_t owner: common.owners()) {
+                const auto cached = common.find(owner);
+                if (!cached) continue; // dropped meanwhile
+
+                const UserModel self = load_user_by_id(owner);
+                const auto reads = CommonFriendIndex::reads_of(self);
+                std::vector<UserModel> friends;
+                for (auto &[_, f]: batch_load_users_by_ids({reads.begin() + 1, reads.end()})) friends.push_back(f);
+
+                if (!cached->bounds(common_friend_counts(self, friends))) {
+                    throw std::runtime_error("Common-friend table of user " + std::to_string(owner) + " drifted");
+                }
+            }
         }
 
 #endif
@@ -536,6 +767,28 @@ namespace social {
     private:
         MYSQL *conn;
         mutable std::mutex mut;
+        mutable ProfileColumns columns;
+        mutable CommonFriendIndex common;
+
+        void load_profile_mirrors() {
+            const char *query = "SELECT user_id, interests_16, base_64_bits FROM UserModels";
+            if (mysql_query(conn, query) != 0) {
+                throw std::runtime_error(std::string("Failed to load profile columns: ") + mysql_error(conn));
+            }
+
+            MYSQL_RES *res = mysql_store_result(conn);
+            if (!res) throw std::runtime_error("mysql_store_result() failed");
+
+            MYSQL_ROW row;
+            while ((row = mysql_fetch_row(res))) {
+                if (!row[0] || !row[1] || !row[2]) continue;
+                const auto id = static_cast<uint32_t>(std::stoul(row[0]));
+                const uint64_t interests_16 = std::stoull(row[1]);
+                const uint64_t base_64_bits = std::stoull(row[2]);
+                columns.set(id, interests_16, base_64_bits);
+            }
+            mysql_free_result(res);
+        }
 
         /// Renew
         void save_user(const UserModel &user) {
@@ -579,6 +832,18 @@ namespace social {
                 throw std::runtime_error(mysql_stmt_error(stmt));
 
             mysql_stmt_close(stmt);
+            columns.set(user.user_id, user.interests_16, user.base_64_bits);
+            user_versions().bump(user.user_id);
+        }
+
+        /// save_user every model @p changes lead to, then patch the common-friend tables in the same order.
+        void save_with_common(const std::initializer_list<ListChange> changes) {
+            std::vector<uint32_t> ids;
+            for (const auto &[_, after]: changes) ids.push_back(after->user_id);
+
+            auto write = common.begin_write(std::move(ids));
+            for (const auto &[_, after]: changes) save_user(*after);
+            write.commit({changes.begin(), changes.size()}, [this](const uint32_t id) { return load_user_by_id(id); });
         }
     };
 }
@@ -0,0 +1,400 @@
+#pragma once
+#include <cstdint>
+#include <jh/pod>
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "UserModel.hpp"
+#include "UserVersions.hpp"
+
+namespace social {
+
+    /// One candidate, its common-friend count and how much of it may be overestimated.
+    JH_POD_STRUCT(CommonFriendEntry,
+                  uint32_t candidate_id;
+                          uint32_t count; /// upper bound of the real count
+                          uint32_t error; /// count - error is a lower bound
+    );
+
+    /**
+     * @brief Space-Saving summary of the non-friends sharing the most friends with one user.
+     *
+     * "Common friend" follows the friend lists as stored, which are not mutual: f counts for candidate c
+     * of owner s when s lists f and f lists c. Invariants, for real count n(c):
+     * - a tracked entry has count - error <= n(c) <= count
+     * - an untracked candidate has n(c) <= floor
+     *
+     * A freshly counted table is exact (error 0, floor = the first count that did not fit). add/remove
+     * keep the invariants in O(TABLE_SIZE); a new candidate evicts the smallest entry once full.
+     */
+    struct CommonFriendTable final {
+        static constexpr size_t TABLE_SIZE = 64;
+
+        pod::array<CommonFriendEntry, TABLE_SIZE> entries; /// free slots have candidate_id == INVALID_FRIEND_ID
+        uint32_t floor; /// no untracked candidate has more common friends
+
+        /// Live entries, largest count first, ties by smaller id.
+        [[nodiscard]] std::vector<CommonFriendEntry> ranked() const {
+            std::vector<CommonFriendEntry> out;
+            out.reserve(TABLE_SIZE);
+            for (const auto &e: entries) {
+                if (e.candidate_id != INVALID_FRIEND_ID) out.push_back(e);
+            }
+            std::sort(out.begin(), out.end(), [](const CommonFriendEntry &a, const CommonFriendEntry &b) {
+                return a.count != b.count ? a.count > b.count : a.candidate_id < b.candidate_id;
+            });
+            return out;
+        }
+
+        /// @p c gained a common friend.
+        void add(const uint32_t c) {
+            CommonFriendEntry *slot = nullptr;
+            for (auto &e: entries) {
+                if (e.candidate_id == c) {
+                    ++e.count;
+                    return;
+                }
+                if (e.candidate_id == INVALID_FRIEND_ID) {
+                    if (!slot || slot->candidate_id != INVALID_FRIEND_ID) slot = &e;
+                } else if (!slot || (slot->candidate_id != INVALID_FRIEND_ID && e.count < slot->count)) {
+                    slot = &e; // smallest entry, unless a free slot is found
+                }
+            }
+            // Untracked: its real count was at most floor, and the evicted one's is now at most its count
+            if (slot->candidate_id != INVALID_FRIEND_ID) floor = std::max(floor, slot->count);
+            *slot = {c, floor + 1, floor};
+        }
+
+        /// @p c lost a common friend; untracked candidates stay under floor.
+        void remove(const uint32_t c) {
+            for (auto &e: entries) {
+                if (e.candidate_id != c) continue;
+                if (--e.count == 0) e = {};
+                return;
+            }
+        }
+
+        /// @p c is no longer a candidate (it became a friend).
+        void erase(const uint32_t c) {
+            for (auto &e: entries) {
+                if (e.candidate_id == c) e = {};
+            }
+        }
+
+        /// Whether the invariants hold against the exact @p counts (candidate -> common friends).
+        [[nodiscard]] bool bounds(const std::unordered_map<uint32_t, uint32_t> &counts) const {
+            std::unordered_set<uint32_t> tracked;
+            for (const auto &e: entries) {
+                if (e.candidate_id == INVALID_FRIEND_ID) continue;
+                const auto it = counts.find(e.candidate_id);
+                const uint32_t n = it == counts.end() ? 0 : it->second;
+                if (n > e.count || n + e.error < e.count) return false;
+                tracked.insert(e.candidate_id);
+            }
+            return std::all_of(counts.begin(), counts.end(), [&](const auto &kv) {
+                return tracked.contains(kv.first) || kv.second <= floor;
+            });
+        }
+    };
+
+    /// Sorted ids @p self lists, without the padding of sorted_friend_ids.
+    inline std::vector<uint32_t> friend_ids(const UserModel &self) {
+        const auto ids = sorted_friend_ids(self);
+        return {ids.begin(), std::lower_bound(ids.begin(), ids.end(), UINT32_MAX)};
+    }
+
+    /**
+     * @brief Exact common-friend count of every candidate of @p self.
+     * @param friends Range of the UserModels @p self lists; friends missing from it count nothing.
+     */
+    template<typename Friends>
+    std::unordered_map<uint32_t, uint32_t> common_friend_counts(const UserModel &self, const Friends &friends) {
+        const auto mine = sorted_friend_ids(self);
+        const auto is_mine = [&](const uint32_t id) { return std::binary_search(mine.begin(), mine.end(), id); };
+
+        std::unordered_map<uint32_t, uint32_t> counts;
+        for (const UserModel &f: friends) {
+            if (f.user_id == self.user_id || !is_mine(f.user_id)) continue;
+            for (const auto &[c, _]: f.friends) {
+                if (c == INVALID_FRIEND_ID || c == self.user_id || is_mine(c)) continue;
+                ++counts[c];
+            }
+        }
+        return counts;
+    }
+
+    /// Count the exact table of @p self from the models of its friends.
+    template<typename Friends>
+    CommonFriendTable count_common_friends(const UserModel &self, const Friends &friends) {
+        std::vector<CommonFriendEntry> ranked;
+        for (const auto &[c, n]: common_friend_counts(self, friends)) {
+            ranked.push_back({c, n, 0});
+        }
+        const auto by_count = [](const CommonFriendEntry &a, const CommonFriendEntry &b) {
+            return a.count != b.count ? a.count > b.count : a.candidate_id < b.candidate_id;
+        };
+        const size_t keep = std::min(CommonFriendTable::TABLE_SIZE + 1, ranked.size());
+        std::partial_sort(ranked.begin(), ranked.begin() + static_cast<std::ptrdiff_t>(keep), ranked.end(), by_count);
+
+        CommonFriendTable table{};
+        std::copy_n(ranked.begin(), std::min(keep, CommonFriendTable::TABLE_SIZE), table.entries.begin());
+        if (keep > CommonFriendTable::TABLE_SIZE) table.floor = ranked[CommonFriendTable::TABLE_SIZE].count;
+        return table;
+    }
+
+    /// Whether @p a and @p b list the same friends, scores aside.
+    inline bool same_friends(const UserModel &a, const UserModel &b) {
+        return sorted_friend_ids(a) == sorted_friend_ids(b);
+    }
+
+    /// One written friend list, as it was and as it is now.
+    struct ListChange final {
+        const UserModel *before;
+        const UserModel *after;
+    };
+
+    /**
+     * @brief At most MAX_TABLES CommonFriendTables, patched in place by every friend-list change.
+     *
+     * Each cached table keeps the friend ids of its owner, and a reverse index maps a user to the owners
+     * listing it. When x adds candidates A and drops R, every owner s listing x gets add(c) for c in A and
+     * remove(c) for c in R (c not s nor a friend of s): O(|A| + |R|) table steps per reader, no reads.
+     * If x owns a table, each friend f it adds turns the candidates f lists into add(c), which takes the
+     * list of f; a friend x drops becomes a candidate of unknown count, so that table is dropped and
+     * counted again on its next use. Tables are evicted least recently used beyond MAX_TABLES.
+     *
+     * Writers wrap their write in begin_write / PendingWrite::commit: while a write is pending, and if
+     * any version it reads moved, put refuses the table a concurrent builder counted, so a change is
+     * applied exactly once to every table, whether it was cached before or after the write.
+     */
+    class CommonFriendIndex final {
+    public:
+        /// Tables kept, about 2 KB each with their friend ids.
+        static constexpr size_t MAX_TABLES = size_t{1} << 14;
+
+        /**
+         * @brief A write between begin_write and commit.
+         *
+         * Destroyed without commit (the write threw), the tables around its users are dropped, since
+         * what reached the database is unknown.
+         */
+        class PendingWrite final {
+        public:
+            PendingWrite(CommonFriendIndex &index, std::vector<uint32_t> ids) : index(index), ids(std::move(ids)) {
+                std::lock_guard lock(index.mut);
+                for (const uint32_t id: this->ids) ++index.pending[id];
+            }
+
+            PendingWrite(const PendingWrite &) = delete;
+
+            PendingWrite &operator=(const PendingWrite &) = delete;
+
+            ~PendingWrite() {
+                if (done) return;
+                std::lock_guard lock(index.mut);
+                for (const uint32_t id: ids) index.invalidate_locked(id);
+                index.release(ids);
+            }
+
+            /**
+             * @brief Apply @p changes, in order, once their rows are written.
+             * @param load Friend list of a user outside @p changes, as it is now (e.g. from the database).
+             */
+            template<typename Load>
+            void commit(const std::span<const ListChange> changes, Load &&load) {
+                std::unordered_map<uint32_t, size_t> order;
+                for (size_t i = 0; i < changes.size(); ++i) order.emplace(changes[i].after->user_id, i);
+
+                std::lock_guard lock(index.mut);
+                for (size_t i = 0; i < changes.size(); ++i) {
+                    // Lists of the batch as they are after changes[0..i) and before the rest
+                    index.apply(*changes[i].before, *changes[i].after, [&](const uint32_t id) -> UserModel {
+                        if (const auto it = order.find(id); it != order.end()) {
+                            return it->second < i ? *changes[it->second].after : *changes[it->second].before;
+                        }
+                        return load(id);
+                    });
+                }
+                index.release(ids);
+                done = true;
+            }
+
+        private:
+            CommonFriendIndex &index;
+            std::vector<uint32_t> ids;
+            bool done = false;
+        };
+
+        /// Announce a write of the rows of @p ids; call before writing them.
+        [[nodiscard]] PendingWrite begin_write(std::vector<uint32_t> ids) {
+            return PendingWrite(*this, std::move(ids));
+        }
+
+        [[nodiscard]] std::optional<CommonFriendTable> find(const uint32_t id) const {
+            std::lock_guard lock(mut);
+            const auto it = tables.find(id);
+            if (it == tables.end()) return std::nullopt;
+            lru.splice(lru.begin(), lru, it->second.used);
+            return it->second.table;
+        }
+
+        /// Users whose lists the table of @p owner reads: @p owner first, then its friends.
+        [[nodiscard]] static std::vector<uint32_t> reads_of(const UserModel &owner) {
+            std::vector<uint32_t> reads{owner.user_id};
+            for (const uint32_t fid: friend_ids(owner)) {
+                if (fid != owner.user_id) reads.push_back(fid);
+            }
+            return reads;
+        }
+
+        /**
+         * @brief Cache the table of @p owner.
+         * @param seen UserVersions of reads_of(@p owner), each taken before that list was read.
+         * @return false (nothing cached) if one of the lists may have changed since, or is being written.
+         */
+        bool put(const UserModel &owner, const CommonFriendTable &table, const std::vector<UserVersions::Version> &seen) {
+            const std::vector<uint32_t> reads = reads_of(owner);
+            if (reads.size() != seen.size()) return false;
+
+            std::lock_guard lock(mut);
+            for (size_t i = 0; i < reads.size(); ++i) {
+                if (pending.contains(reads[i]) || user_versions().get(reads[i]) != seen[i]) return false;
+            }
+
+            drop(owner.user_id);
+            if (tables.size() >= MAX_TABLES) drop(lru.back());
+
+            lru.push_front(owner.user_id);
+            Entry entry{table, friend_ids(owner), lru.begin()};
+            for (const uint32_t id: entry.friends) {
+                if (id != owner.user_id) readers[id].insert(owner.user_id);
+            }
+            tables.emplace(owner.user_id, std::move(entry));
+            return true;
+        }
+
+        /// The list of @p id was replaced by an unknown one: drop its table and every table reading it.
+        void invalidate(const uint32_t id) {
+            std::lock_guard lock(mut);
+            invalidate_locked(id);
+        }
+
+        [[nodiscard]] bool empty() const {
+            std::lock_guard lock(mut);
+            return tables.empty();
+        }
+
+        void clear() {
+            std::lock_guard lock(mut);
+            tables.clear();
+            readers.clear();
+            lru.clear();
+        }
+
+        /// Owners of the cached tables, e.g. to check them against a recount.
+        [[nodiscard]] std::vector<uint32_t> owners() const {
+            std::lock_guard lock(mut);
+            return {lru.begin(), lru.end()};
+        }
+
+    private:
+        struct Entry {
+            CommonFriendTable table;
+            std::vector<uint32_t> friends; /// friend_ids(owner), as counted and patched
+            std::list<uint32_t>::iterator used;
+        };
+
+        mutable std::mutex mut;
+        std::unordered_map<uint32_t, Entry> tables;
+        std::unordered_map<uint32_t, std::unordered_set<uint32_t>> readers; /// user -> owners listing it
+        std::unordered_map<uint32_t, uint32_t> pending; /// user -> writes begun and not yet applied
+        mutable std::list<uint32_t> lru; /// owners, most recently used first
+
+        /// Requires mut.
+        void drop(const uint32_t owner) {
+            const auto it = tables.find(owner);
+            if (it == tables.end()) return;
+            for (const uint32_t id: it->second.friends) {
+                const auto r = readers.find(id);
+                if (r == readers.end()) continue;
+                r->second.erase(owner);
+                if (r->second.empty()) readers.erase(r);
+            }
+            lru.erase(it->second.used);
+            tables.erase(it);
+        }
+
+        /// Requires mut.
+        void invalidate_locked(const uint32_t id) {
+            drop(id);
+            if (const auto it = readers.find(id); it != readers.end()) {
+                const std::vector<uint32_t> stale(it->second.begin(), it->second.end());
+                for (const uint32_t owner: stale) drop(owner);
+            }
+        }
+
+        /// Requires mut.
+        void release(const std::vector<uint32_t> &ids) {
+            for (const uint32_t id: ids) {
+                if (const auto it = pending.find(id); it != pending.end() && --it->second == 0) pending.erase(it);
+            }
+        }
+
+        /// Requires mut. Patch every table that reads the list of @p after.user_id.
+        template<typename Lookup>
+        void apply(const UserModel &before, const UserModel &after, Lookup &&lookup) {
+            const uint32_t x = after.user_id;
+            const std::vector<uint32_t> old_ids = friend_ids(before), new_ids = friend_ids(after);
+            if (old_ids == new_ids) return;
+
+            std::vector<uint32_t> added, removed;
+            std::set_difference(new_ids.begin(), new_ids.end(), old_ids.begin(), old_ids.end(), std::back_inserter(added));
+            std::set_difference(old_ids.begin(), old_ids.end(), new_ids.begin(), new_ids.end(), std::back_inserter(removed));
+
+            // Tables of the owners listing x: its new and dropped friends are their candidates
+            if (const auto r = readers.find(x); r != readers.end()) {
+                for (const uint32_t s: r->second) {
+                    auto &[table, friends, _] = tables.at(s);
+                    const auto is_candidate = [&](const uint32_t c) {
+                        return c != s && !std::binary_search(friends.begin(), friends.end(), c);
+                    };
+                    for (const uint32_t c: added) {
+                        if (is_candidate(c)) table.add(c);
+                    }
+                    for (const uint32_t c: removed) {
+                        if (is_candidate(c)) table.remove(c);
+                    }
+                }
+            }
+
+            // The table of x itself
+            const auto own = tables.find(x);
+            if (own == tables.end()) return;
+            if (!removed.empty()) {
+                drop(x);
+                return;
+            }
+            auto &[table, friends, _] = own->second;
+            for (const uint32_t f: added) {
+                table.erase(f);
+                if (f != x) readers[f].insert(x);
+            }
+            friends = new_ids;
+            for (const uint32_t f: added) {
+                if (f == x) continue;
+                const UserModel model = lookup(f);
+                for (const auto &[c, score]: model.friends) {
+                    if (c != INVALID_FRIEND_ID && c != x && !std::binary_search(new_ids.begin(), new_ids.end(), c)) {
+                        table.add(c);
+                    }
+                }
+            }
+        }
+    };
+
+}
@@ -0,0 +1,167 @@
+#pragma once
+#include <cstdint>
+#include <jh/pod>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+namespace pod = jh::pod;
+
+namespace social {
+
+    /**
+     * @brief Exact Hamming k-NN over 64-bit codes by multi-index hashing.
+     *
+     * Each code is cut into 4 substrings of 16 bits, every substring keys its own table.
+     * Two codes at distance d agree within floor(d / 4) bits on at least one substring, so
+     * after probing every table up to substring radius s, all codes within 4s + 3 are known.
+     * Queries widen s until K results fall inside that bound, touching only nearby buckets.
+     *
+     * Substring j takes the bits at positions j, j + 4, j + 8, ... so the 16 one-hot bits of
+     * base_64_bits are spread over all tables instead of collapsing one table to 256 keys.
+     */
+    class HammingIndex final {
+    public:
+        static constexpr uint32_t SUBSTRINGS = 4;
+        static constexpr uint32_t SUBSTRING_BITS = 64 / SUBSTRINGS;
+        static constexpr size_t BUCKETS = size_t{1} << SUBSTRING_BITS;
+
+        /// Insert @p id or move it to a new @p code.
+        void insert(const uint32_t id, const uint64_t code) {
+            std::unique_lock lock(mut);
+            if (tables[0].empty()) {
+                for (auto &table: tables) table.resize(BUCKETS);
+            }
+            if (id >= codes.size()) {
+                codes.resize(static_cast<size_t>(id) + 1, 0);
+                present.resize(static_cast<size_t>(id) + 1, 0);
+            }
+
+            if (present[id]) {
+                if (codes[id] == code) return;
+                for (uint32_t j = 0; j < SUBSTRINGS; ++j) {
+                    auto &bucket = tables[j][substring(codes[id], j)];
+                    bucket.erase(std::find(bucket.begin(), bucket.end(), id));
+                }
+            } else {
+                present[id] = 1;
+                ++count;
+            }
+
+            codes[id] = code;
+            for (uint32_t j = 0; j < SUBSTRINGS; ++j) {
+                tables[j][substring(code, j)].push_back(id);
+            }
+        }
+
+        void clear() {
+            std::unique_lock lock(mut);
+            for (auto &table: tables) {
+                table.clear();
+                table.shrink_to_fit();
+            }
+            codes.clear();
+            present.clear();
+            count = 0;
+        }
+
+        [[nodiscard]] size_t size() const {
+            std::shared_lock lock(mut);
+            return count;
+        }
+
+        /**
+         * @brief The K codes closest to @p query, ties broken by smaller id.
+         * @param exclude Predicate on user ids that must never be returned (self, friends, ...).
+         * @return <id, 64 - distance> (the match_basics score), best first; unused entries are {INVALID, 0}.
+         */
+        template<size_t K, typename Exclude>
+        pod::array<pod::pair<uint32_t, uint8_t>, K> nearest(const uint64_t query, Exclude &&exclude) const {
+            struct Hit {
+                uint8_t distance;
+                uint32_t id;
+            };
+
+            std::vector<Hit> found;
+
+            std::shared_lock lock(mut);
+            if (!tables[0].empty()) {
+                const auto &masks = masks_by_weight();
+                uint32_t query_keys[SUBSTRINGS];
+                for (uint32_t j = 0; j < SUBSTRINGS; ++j) query_keys[j] = substring(query, j);
+
+                for (uint32_t radius = 0; radius <= SUBSTRING_BITS; ++radius) {
+                    for (uint32_t j = 0; j < SUBSTRINGS; ++j) {
+                        for (const uint16_t mask: masks[radius]) {
+                            for (const uint32_t id: tables[j][query_keys[j] ^ mask]) {
+                                const uint64_t diff = codes[id] ^ query;
+                                if (seen_before(diff, j, radius) || exclude(id)) continue;
+                                found.push_back({static_cast<uint8_t>(std::popcount(diff)), id});
+                            }
+                        }
+                    }
+
+                    // Every code within `bound` has been seen, anything unseen is strictly farther
+                    const uint32_t bound = SUBSTRINGS * (radius + 1) - 1;
+                    const auto settled = std::count_if(found.begin(), found.end(),
+                                                       [bound](const Hit &h) { return h.distance <= bound; });
+                    if (static_cast<size_t>(settled) >= K) break;
+                }
+            }
+
+            const size_t n = std::min(K, found.size());
+            std::partial_sort(found.begin(), found.begin() + static_cast<std::ptrdiff_t>(n), found.end(),
+                              [](const Hit &a, const Hit &b) {
+                                  return a.distance != b.distance ? a.distance < b.distance : a.id < b.id;
+                              });
+
+            pod::array<pod::pair<uint32_t, uint8_t>, K> result{};
+            for (size_t i = 0; i < n; ++i) {
+                result[i] = {found[i].id, static_cast<uint8_t>(64 - found[i].distance)};
+            }
+            return result;
+        }
+
+    private:
+        mutable std::shared_mutex mut;
+        std::array<std::vector<std::vector<uint32_t>>, SUBSTRINGS> tables;
+        std::vector<uint64_t> codes;    /// by user id
+        std::vector<uint8_t> present;   /// by user id
+        size_t count = 0;
+
+        static constexpr uint64_t SUBSTRING_MASK = 0x1111111111111111ULL;
+
+        /// True if the code was already reached by an earlier (radius, table) probe, so no visited set is needed.
+        static constexpr bool seen_before(const uint64_t diff, const uint32_t table, const uint32_t radius) noexcept {
+            for (uint32_t j = 0; j < SUBSTRINGS; ++j) {
+                const auto d = static_cast<uint32_t>(std::popcount(diff & (SUBSTRING_MASK << j)));
+                if (d < radius || (d == radius && j < table)) return true;
+            }
+            return false;
+        }
+
+        static constexpr uint32_t substring(const uint64_t code, const uint32_t j) noexcept {
+            uint32_t key = 0;
+            for (uint32_t b = 0; b < SUBSTRING_BITS; ++b) {
+                key |= static_cast<uint32_t>((code >> (b * SUBSTRINGS + j)) & 1) << b;
+            }
+            return key;
+        }
+
+        /// All 16-bit masks grouped by popcount, the probe order of one table.
+        static const std::array<std::vector<uint16_t>, SUBSTRING_BITS + 1> &masks_by_weight() {
+            static const auto masks = [] {
+                std::array<std::vector<uint16_t>, SUBSTRING_BITS + 1> m;
+                for (uint32_t v = 0; v < BUCKETS; ++v) {
+                    m[std::popcount(v)].push_back(static_cast<uint16_t>(v));
+                }
+                return m;
+            }();
+            return masks;
+        }
+    };
+
+}
@@ -0,0 +1,169 @@
+#pragma once
+#include <cstdint>
+#include <jh/pod>
+#include <algorithm>
+#include <shared_mutex>
+#include <mutex>
+#include <vector>
+#include "HammingIndex.hpp"
+#include "UserModel.hpp"
+#include "../Utils/ParallelFor.hpp"
+
+namespace social {
+
+    /**
+     * @brief Packed per-user columns (interests_16, base_64_bits) indexed by user id.
+     *
+     * Structure-of-arrays mirror of UserModels for full scans: one pass streams two
+     * contiguous uint64_t arrays instead of touching 2 KiB friend blobs per user.
+     *
+     * The only mirror writers update: every base_64_bits it takes is passed on to basics_index(),
+     * which keeps its own copy per id to find the buckets of a code that moves.
+     */
+    class ProfileColumns final {
+    public:
+        /// Below this many users a scan stays on the calling thread.
+        static constexpr size_t PARALLEL_MIN = size_t{1} << 16;
+        /// Ids per parallel scan part, each with its own K-heap.
+        static constexpr size_t PART_SIZE = PARALLEL_MIN / 4;
+
+        /// Hamming index over the same base_64_bits, fed by set / set_bits.
+        [[nodiscard]] const HammingIndex &basics_index() const noexcept {
+            return basics;
+        }
+
+        void set(const uint32_t id, const uint64_t interests_16, const uint64_t base_64_bits) {
+            std::unique_lock lock(mut);
+            reserve_id(id);
+            interests[id] = interests_16;
+            bits[id] = base_64_bits;
+            present[id] = 1;
+            basics.insert(id, base_64_bits);
+        }
+
+        void set_interests(const uint32_t id, const uint64_t interests_16) {
+            std::unique_lock lock(mut);
+            reserve_id(id);
+            interests[id] = interests_16;
+        }
+
+        void set_bits(const uint32_t id, const uint64_t base_64_bits) {
+            std::unique_lock lock(mut);
+            reserve_id(id);
+            bits[id] = base_64_bits;
+            basics.insert(id, base_64_bits);
+        }
+
+        void clear() {
+            std::unique_lock lock(mut);
+            interests.clear();
+            bits.clear();
+            present.clear();
+            basics.clear();
+        }
+
+        /**
+         * @brief Exact top-K by match_basics + match_interests over every stored user.
+         *
+         * Large id ranges are cut into PART_SIZE parts scanned on fabric::parallel_for (no thread is
+         * created per query), each part keeps its own K-heap, heaps are merged at the end. Ties go to
+         * the smaller id, so the result does not depend on the thread count.
+         *
+         * @param excluded Bitmap over user ids (bit set = never returned), e.g. self and friends.
+         * @return <id, combined score> best first; unused entries are {INVALID_FRIEND_ID, 0}.
+         */
+        template<size_t K>
+        pod::array<pod::pair<uint32_t, uint16_t>, K>
+        top_k(const uint64_t self_interests, const uint64_t self_bits, const std::vector<uint64_t> &excluded) const {
+            using Hit = pod::pair<uint32_t, uint16_t>;
+
+            std::shared_lock lock(mut);
+            const size_t n = present.size();
+
+            const auto scan = [&](const size_t begin, const size_t end) {
+                // min-heap on (score, -id): the front is the worst kept hit
+                const auto worse = [](const Hit &a, const Hit &b) {
+                    return a.second != b.second ? a.second > b.second : a.first < b.first;
+                };
+                std::vector<Hit> heap;
+                heap.reserve(K);
+                int32_t threshold = -1; // score to beat once the heap is full
+
+                // Score a block branch-free (vectorizable), then only look at the few that beat the heap
+                constexpr size_t BLOCK = 256;
+                uint16_t scores[BLOCK];
+
+                for (size_t base = begin; base < end; base += BLOCK) {
+                    const size_t len = std::min(BLOCK, end - base);
+                    const uint64_t *block_bits = bits.data() + base;
+                    const uint64_t *block_interests = interests.data() + base;
+                    for (size_t k = 0; k < len; ++k) {
+                        scores[k] = static_cast<uint16_t>(match_basics(self_bits, block_bits[k]) +
+                                                          match_interests_swar(self_interests, block_interests[k]));
+                    }
+
+                    for (size_t k = 0; k < len; ++k) {
+                        // ids grow within a range, so an equal score never beats the kept one
+                        if (static_cast<int32_t>(scores[k]) <= threshold) continue;
+
+                        const size_t id = base + k;
+                        if (!present[id] || (id / 64 < excluded.size() && (excluded[id / 64] >> (id % 64)) & 1)) {
+                            continue;
+                        }
+
+                        if (heap.size() == K) {
+                            std::pop_heap(heap.begin(), heap.end(), worse);
+                            heap.pop_back();
+                        }
+                        heap.push_back({static_cast<uint32_t>(id), scores[k]});
+                        std::push_heap(heap.begin(), heap.end(), worse);
+                        if (heap.size() == K) threshold = heap.front().second;
+                    }
+                }
+                return heap;
+            };
+
+            std::vector<Hit> merged;
+            if (n < PARALLEL_MIN) {
+                merged = scan(0, n);
+            } else {
+                std::vector<std::vector<Hit>> parts((n + PART_SIZE - 1) / PART_SIZE);
+                fabric::parallel_for(parts.size(), 1, [&](const size_t p) {
+                    parts[p] = scan(p * PART_SIZE, std::min(n, (p + 1) * PART_SIZE));
+                });
+                merged.reserve(parts.size() * K);
+                for (const auto &hits: parts) {
+                    merged.insert(merged.end(), hits.begin(), hits.end());
+                }
+            }
+
+            const size_t count = std::min(K, merged.size());
+            std::partial_sort(merged.begin(), merged.begin() + static_cast<std::ptrdiff_t>(count), merged.end(),
+                              [](const Hit &a, const Hit &b) {
+                                  return a.second != b.second ? a.second > b.second : a.first < b.first;
+                              });
+
+            pod::array<Hit, K> result{};
+            for (size_t i = 0; i < count; ++i) {
+                result[i] = merged[i];
+            }
+            return result;
+        }
+
+    private:
+        mutable std::shared_mutex mut;
+        std::vector<uint64_t> interests; /// by user id
+        std::vector<uint64_t> bits;      /// by user id
+        std::vector<uint8_t> present;    /// by user id
+        HammingIndex basics;             /// written under mut, so both mirrors move together
+
+        void reserve_id(const uint32_t id) {
+            if (id < present.size()) return;
+            const size_t size = static_cast<size_t>(id) + 1;
+            interests.resize(size, 0);
+            bits.resize(size, 0);
+            present.resize(size, 0);
+        }
+    };
+
+}
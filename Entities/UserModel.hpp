@@ -2,6 +2,7 @@
 #include <cstdint>
 #include <jh/pod>
 #include <algorithm> // for std::sort
+#include <bit>       // for std::popcount
 #include <cstring>   // for std::memcpy
 #include <sstream>   // NOLINT for std::ostream
 
@@ -21,6 +22,45 @@ namespace social{
         friend_list friends;  /// not followers but regularly interacted people
     };
 
+    /// Which parts of a UserModel differ from its persisted row.
+    struct UserDirtyMask final {
+        pod::array<uint64_t, friend_list::size() / 64> slots;  /// one bit per friend slot
+        bool interests;
+        bool bits;
+
+        [[nodiscard]] constexpr bool any_slot() const noexcept {
+            return std::any_of(slots.begin(), slots.end(), [](const uint64_t w) { return w != 0; });
+        }
+
+        [[nodiscard]] constexpr bool any() const noexcept {
+            return interests || bits || any_slot();
+        }
+
+        [[nodiscard]] constexpr bool slot(const size_t i) const noexcept {
+            return (slots[i / 64] >> (i % 64)) & 1;
+        }
+    };
+
+    /// A modified user together with what changed since it was loaded.
+    struct DirtyUser final {
+        const UserModel *user;
+        UserDirtyMask mask;
+    };
+
+    inline UserDirtyMask diff_user(const UserModel &before, const UserModel &after) {
+        UserDirtyMask mask{};
+        mask.interests = before.interests_16 != after.interests_16;
+        mask.bits = before.base_64_bits != after.base_64_bits;
+        for (size_t i = 0; i < friend_list::size(); ++i) {
+            const auto &[id_a, score_a] = before.friends[i];
+            const auto &[id_b, score_b] = after.friends[i];
+            if (id_a != id_b || score_a != score_b) {
+                mask.slots[i / 64] |= uint64_t{1} << (i % 64);
+            }
+        }
+        return mask;
+    }
+
     constexpr uint8_t match_interests(uint64_t a, uint64_t b) {
         uint8_t res = 0;
         for (uint8_t i = 0; i < 16; ++i) {
@@ -34,6 +74,35 @@ namespace social{
         return res;
     }
 
+    /**
+     * @brief Branch-free match_interests, 8 interests per 64-bit word (SIMD within a register).
+     *
+     * Even and odd nibbles are widened to byte lanes and |a - b| is taken per lane without
+     * cross-lane borrows. The weight 8 >> diff is then built from the low diff bits (0 when
+     * diff >= 4) and all lanes are summed with one multiply. Always equal to match_interests(a, b).
+     */
+    constexpr uint8_t match_interests_swar(const uint64_t a, const uint64_t b) {
+        constexpr uint64_t LO = 0x0F0F0F0F0F0F0F0FULL;
+        constexpr uint64_t ONES = 0x0101010101010101ULL;
+
+        const auto lane_weights = [](const uint64_t x, const uint64_t y) {
+            const uint64_t t = (x | (ONES << 4)) - y;   // 16 + x - y, in [1, 31] per lane
+            const uint64_t ge = (t >> 4) & ONES;        // 1 where x >= y
+            const uint64_t keep = (ge << 8) - ge;       // 0xFF where x >= y
+            const uint64_t diff = (t & LO & keep) | ((((t ^ LO) & LO) + ONES) & ~keep);
+
+            // 8 >> diff for diff < 4 is 8, 4, 2, 1 = 8 + 3 * d0 * d1 - 4 * d0 - 6 * d1
+            const uint64_t d0 = diff & ONES;
+            const uint64_t d1 = (diff >> 1) & ONES;
+            const uint64_t near = ~((diff >> 2) | (diff >> 3)) & ONES;
+            const uint64_t w = (ONES * 8 + 3 * (d0 & d1)) - (4 * d0 + 6 * d1);
+            return w & ((near << 8) - near);
+        };
+
+        const uint64_t weights = lane_weights(a & LO, b & LO) + lane_weights((a >> 4) & LO, (b >> 4) & LO);
+        return static_cast<uint8_t>((weights * ONES) >> 56);
+    }
+
     constexpr uint8_t match_basics(uint64_t a, uint64_t b) {
 #if defined(__GNUC__) || defined(__clang__)
         return 64 - __builtin_popcountll(a ^ b);
@@ -51,7 +120,7 @@ namespace social{
         for (auto&[first, second] : self.friends) {
             if (first == friend_id || first == INVALID_FRIEND_ID) {
                 first = friend_id;
-                second += amount;
+                second = amount > UINT32_MAX - second ? UINT32_MAX : second + amount; // saturate, never wrap
                 return;
             }
         }
@@ -145,6 +214,18 @@ namespace social{
         });
     }
 
+    /// Sorted friend ids of @p self, for O(log 256) membership tests in hot loops.
+    inline pod::array<uint32_t, 256> sorted_friend_ids(const UserModel &self) {
+        pod::array<uint32_t, 256> ids{};
+        size_t n = 0;
+        for (const auto &[fid, _]: self.friends) {
+            if (fid != INVALID_FRIEND_ID) ids[n++] = fid;
+        }
+        std::sort(ids.begin(), ids.begin() + n);
+        for (size_t i = n; i < ids.size(); ++i) ids[i] = UINT32_MAX; // keep the tail sorted
+        return ids;
+    }
+
     inline std::ostream& operator<<(std::ostream& os, const UserModel& u) {
         os << "UserModel ID: " << u.user_id << "\n";
         os << "Interests_16: 0x" << std::hex << u.interests_16 << std::dec << "\n";
@@ -0,0 +1,83 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <random>
+
+namespace social {
+
+    /**
+     * @brief Per-user change counters, bumped by every write path of the model and fabric handlers.
+     *
+     * Reads are O(1) and lock-free: a two-level table of atomic counters, pages allocated on the first
+     * bump of one of their ids. A user never bumped reads as version 0. bump_all() moves the generation
+     * instead of touching every counter, for truncates and reconnects; the generation starts random so
+     * versions of an earlier process never collide with this one's.
+     *
+     * Writers bump after their write is committed, readers take the version before they read: a read
+     * racing a write may return new data under the old version, never old data under the new one.
+     */
+    class UserVersions final {
+    public:
+        struct Version {
+            uint64_t generation;
+            uint32_t counter;
+
+            bool operator==(const Version &) const = default;
+        };
+
+        UserVersions() {
+            std::random_device rd;
+            generation.store(static_cast<uint64_t>(rd()) << 32 | rd(), std::memory_order_relaxed);
+        }
+
+        UserVersions(const UserVersions &) = delete;
+
+        UserVersions &operator=(const UserVersions &) = delete;
+
+        ~UserVersions() {
+            for (auto &page: pages) delete page.load(std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] Version get(const uint32_t id) const noexcept {
+            const uint64_t gen = generation.load(std::memory_order_acquire);
+            const Page *page = pages[id >> PAGE_BITS].load(std::memory_order_acquire);
+            return {gen, page ? (*page)[id & PAGE_MASK].load(std::memory_order_acquire) : 0};
+        }
+
+        void bump(const uint32_t id) {
+            page_for(id)[id & PAGE_MASK].fetch_add(1, std::memory_order_acq_rel);
+        }
+
+        /// Every user changed (table truncated, other database).
+        void bump_all() noexcept {
+            generation.fetch_add(1, std::memory_order_acq_rel);
+        }
+
+    private:
+        static constexpr uint32_t PAGE_BITS = 16;
+        static constexpr uint32_t PAGE_MASK = (1u << PAGE_BITS) - 1;
+        using Page = std::array<std::atomic<uint32_t>, size_t{1} << PAGE_BITS>;
+
+        std::array<std::atomic<Page *>, size_t{1} << (32 - PAGE_BITS)> pages{};
+        std::atomic<uint64_t> generation{0};
+
+        Page &page_for(const uint32_t id) {
+            auto &slot = pages[id >> PAGE_BITS];
+            Page *page = slot.load(std::memory_order_acquire);
+            if (page) return *page;
+
+            auto *fresh = new Page{};
+            if (slot.compare_exchange_strong(page, fresh, std::memory_order_acq_rel)) return *fresh;
+            delete fresh; // another writer installed it first
+            return *page;
+        }
+    };
+
+    /// The process-wide table, shared by UserModelHandler and fabric::FabricInfoHandler.
+    inline UserVersions &user_versions() {
+        static UserVersions versions;
+        return versions;
+    }
+
+}
@@ -6,8 +6,7 @@
 #include <utility>
 #include <cstdint>
 #include <random>
-
-extern std::mt19937 &global_rng();
+#include "Random.hpp"
 
 namespace fabric {
     static constexpr jh::pod::array<const char *, 64> male_names =
@@ -233,48 +232,53 @@ namespace fabric {
         return result;
     }
 
-    uint64_t generate_random_interests() {
-        auto &gen = global_rng();
+    /// Stack-only: one partial Fisher-Yates over a nibble-packed permutation, 3 draws per user.
+    uint64_t generate_random_interests(rng_engine &gen = global_rng()) {
+        const uint64_t r0 = gen();
+        uint64_t r1 = gen();
+        uint64_t r2 = gen();
 
-        std::uniform_int_distribution<> strong_dist(5, 15);
-        std::uniform_int_distribution<> weak_dist(0, 7);
-        std::uniform_int_distribution<> strong_count_dist(3, 5);
+        // 3..5 strong interests (5..15), all others weak (0..7): 3 random bits per nibble
+        const uint32_t strong_count = 3 + static_cast<uint32_t>(((r0 >> 48) * 3) >> 16);
+        uint64_t bits = 0;
+        for (uint32_t i = 0; i < 16; ++i) {
+            bits |= ((r0 >> (3 * i)) & 0x7) << (4 * i);
+        }
 
-        std::vector<int> indices(16);
-        std::iota(indices.begin(), indices.end(), 0);
-        std::shuffle(indices.begin(), indices.end(), gen);
+        uint64_t perm = 0xFEDCBA9876543210ULL; // nibble i holds interest index i
+        for (uint32_t i = 0; i < strong_count; ++i) {
+            const uint32_t j = i + static_cast<uint32_t>(((r1 & 0xFFF) * (16 - i)) >> 12);
+            r1 >>= 12;
 
-        size_t strong_count = strong_count_dist(gen);
-        uint64_t bits = 0;
+            // swap nibbles i and j
+            const uint64_t a = (perm >> (4 * i)) & 0xF;
+            const uint64_t b = (perm >> (4 * j)) & 0xF;
+            perm ^= ((a ^ b) << (4 * i)) | ((a ^ b) << (4 * j));
+
+            const uint64_t val = 5 + (((r2 & 0xFFF) * 11) >> 12);
+            r2 >>= 12;
 
-        for (size_t i = 0; i < 16; ++i) {
-            uint8_t val = (i < strong_count)
-                          ? strong_dist(gen)
-                          : weak_dist(gen);
-            bits |= (uint64_t(val & 0xF) << (indices[i] * 4));
+            const uint32_t shift = 4 * static_cast<uint32_t>(b);
+            bits = (bits & ~(uint64_t{0xF} << shift)) | (val << shift);
         }
 
         return bits;
     }
 
 
-    uint64_t generate_random_tags() {
-        auto &gen = global_rng();
+    /// One draw: 48 boolean bits + four 2-bit one-hot picks.
+    uint64_t generate_random_tags(rng_engine &gen = global_rng()) {
+        const uint64_t r = gen();
 
-        uint64_t bits = 0;
+        // Boolean tags (remaining 48 bits)
+        uint64_t bits = (r & ((1ULL << 48) - 1)) << 16;
 
         // One-hot: 4 groups of 4 tags (first 16 bits)
-        for (int group = 0; group < 4; ++group) {
-            int base = group * 4;
-            int pick = std::uniform_int_distribution<>(0, 3)(gen);
-            bits |= (1ULL << (base + pick));
+        for (uint32_t group = 0; group < 4; ++group) {
+            const uint64_t pick = (r >> (48 + 2 * group)) & 0x3;
+            bits |= 1ULL << (group * 4 + pick);
         }
 
-        // Boolean tags (remaining 48 bits)
-        uint64_t boolean_part = std::uniform_int_distribution<uint64_t>(
-                0, (1ULL << 48) - 1)(gen);
-        bits |= (boolean_part << 16);
-
         return bits;
     }
 
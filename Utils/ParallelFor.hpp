@@ -0,0 +1,212 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fabric {
+
+    /**
+     * @brief Fixed set of helper threads shared by every parallel_for, started once.
+     *
+     * Tasks run in posting order; they must not block on each other.
+     */
+    class ParallelPool final {
+    public:
+        explicit ParallelPool(const size_t threads) {
+            helpers.reserve(threads);
+            for (size_t i = 0; i < threads; ++i) {
+                helpers.emplace_back([this] { work(); });
+            }
+        }
+
+        ParallelPool(const ParallelPool &) = delete;
+        ParallelPool &operator=(const ParallelPool &) = delete;
+
+        ~ParallelPool() {
+            {
+                std::lock_guard lock(mut);
+                stopping = true;
+            }
+            ready.notify_all();
+            for (auto &t: helpers) t.join();
+        }
+
+        [[nodiscard]] size_t size() const { return helpers.size(); }
+
+        void post(std::function<void()> task) {
+            {
+                std::lock_guard lock(mut);
+                tasks.push_back(std::move(task));
+            }
+            ready.notify_one();
+        }
+
+    private:
+        std::mutex mut;
+        std::condition_variable ready;
+        std::deque<std::function<void()>> tasks;
+        bool stopping = false;
+        std::vector<std::thread> helpers;
+
+        void work() {
+            for (;;) {
+                std::function<void()> task;
+                {
+                    std::unique_lock lock(mut);
+                    ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+                    if (tasks.empty()) return; // stopping
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+                task();
+            }
+        }
+    };
+
+    /// The helpers of parallel_for: one per core besides the calling thread.
+    inline ParallelPool &parallel_pool() {
+        static ParallelPool pool(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+        return pool;
+    }
+
+    /**
+     * @brief Run body(i) for every i in [0, n) on the calling thread and parallel_pool(), balancing by range stealing.
+     *
+     * Each worker starts with an equal slice of the index range, packed as (begin, end) in one 64-bit
+     * atomic. The owner takes @p grain indices at a time from the front; a worker whose slice is empty
+     * steals the back half of the fullest other slice. Uneven bodies (a node with 256 friends next to one
+     * with 3) therefore keep every thread busy until the whole range is done.
+     *
+     * The calling thread is worker 0 and the helpers join in as the pool gets to them; no thread is
+     * created per call. A helper that only starts once the range is done, e.g. because the pool is busy
+     * with another call, leaves without touching it, so a call never waits for a busy pool. The first
+     * exception thrown by any body is rethrown after all workers have stopped. n must fit in 32 bits.
+     *
+     * @param workers At most this many threads, capped at parallel_pool().size() + 1.
+     */
+    template<typename Body>
+    void parallel_for(const size_t n, const size_t grain, Body &&body, size_t workers = SIZE_MAX) {
+        if (n == 0) return;
+        const size_t step = std::max<size_t>(grain, 1);
+        workers = std::clamp<size_t>(std::min(workers, parallel_pool().size() + 1), 1, (n + step - 1) / step);
+        if (workers == 1) {
+            for (size_t i = 0; i < n; ++i) body(i);
+            return;
+        }
+
+        const auto pack = [](const uint64_t begin, const uint64_t end) { return begin << 32 | end; };
+        const auto begin_of = [](const uint64_t range) { return range >> 32; };
+        const auto end_of = [](const uint64_t range) { return range & 0xFFFFFFFFULL; };
+
+        // one cache line per slice, owners and thieves hammer these
+        struct alignas(64) Slice {
+            std::atomic<uint64_t> range;
+        };
+        const std::unique_ptr<Slice[]> slices(new Slice[workers]);
+        for (size_t w = 0; w < workers; ++w) {
+            slices[w].range.store(pack(n * w / workers, n * (w + 1) / workers), std::memory_order_relaxed);
+        }
+
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+        std::mutex error_mut;
+
+        const auto run = [&](const size_t self) {
+            try {
+                for (;;) {
+                    // Own slice: take up to `grain` from the front
+                    auto &mine = slices[self].range;
+                    uint64_t range = mine.load(std::memory_order_acquire);
+                    while (begin_of(range) < end_of(range)) {
+                        const uint64_t begin = begin_of(range);
+                        const uint64_t stop = std::min<uint64_t>(begin + step, end_of(range));
+                        if (!mine.compare_exchange_weak(range, pack(stop, end_of(range)), std::memory_order_acq_rel)) {
+                            continue;
+                        }
+                        for (uint64_t i = begin; i < stop; ++i) {
+                            if (failed.load(std::memory_order_relaxed)) return;
+                            body(static_cast<size_t>(i));
+                        }
+                        range = mine.load(std::memory_order_acquire);
+                    }
+
+                    // Empty: steal the back half of the largest remaining slice
+                    size_t victim = workers;
+                    uint64_t largest = 0;
+                    for (size_t w = 0; w < workers; ++w) {
+                        const uint64_t r = slices[w].range.load(std::memory_order_acquire);
+                        const uint64_t left = end_of(r) > begin_of(r) ? end_of(r) - begin_of(r) : 0;
+                        if (w != self && left > largest) {
+                            largest = left;
+                            victim = w;
+                        }
+                    }
+                    if (victim == workers) return; // nothing left anywhere
+
+                    auto &theirs = slices[victim].range;
+                    uint64_t r = theirs.load(std::memory_order_acquire);
+                    const uint64_t b = begin_of(r), e = end_of(r);
+                    if (b >= e) continue;
+                    const uint64_t mid = b + (e - b) / 2; // a single index is stolen whole
+                    if (theirs.compare_exchange_strong(r, pack(b, mid), std::memory_order_acq_rel)) {
+                        mine.store(pack(mid, e), std::memory_order_release);
+                    }
+                }
+            } catch (...) {
+                std::lock_guard lock(error_mut);
+                if (!failed.exchange(true)) error = std::current_exception();
+            }
+        };
+
+        // Helpers outlive this frame in the pool queue: they reach `run` only through `join`, and only
+        // while it is open
+        struct Join {
+            std::mutex mut;
+            std::condition_variable idle;
+            bool open = true;
+            size_t active = 0;
+            size_t next = 1;
+            const std::function<void(size_t)> *run;
+        };
+        const std::function<void(size_t)> run_fn = run;
+        const auto join = std::make_shared<Join>();
+        join->run = &run_fn;
+
+        for (size_t w = 1; w < workers; ++w) {
+            parallel_pool().post([join] {
+                size_t self;
+                {
+                    std::lock_guard lock(join->mut);
+                    if (!join->open) return;
+                    ++join->active;
+                    self = join->next++;
+                }
+                (*join->run)(self);
+                {
+                    std::lock_guard lock(join->mut);
+                    --join->active;
+                }
+                join->idle.notify_all();
+            });
+        }
+        run(0);
+        {
+            // Every slice is empty once worker 0 is out of work; wait for the helpers still in it
+            std::unique_lock lock(join->mut);
+            join->open = false;
+            join->idle.wait(lock, [&] { return join->active == 0; });
+        }
+
+        if (error) std::rethrow_exception(error);
+    }
+
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+namespace fabric {
+
+    /**
+     * @brief xoshiro256** generator (Blackman & Vigna), seeded through splitmix64.
+     *
+     * Satisfies UniformRandomBitGenerator, so it drops into every std distribution.
+     * Streams are split with jump-ahead instead of re-seeding:
+     * - jump()      advances by 2^128 draws (per-worker streams, see split()).
+     * - long_jump() advances by 2^192 draws (per-thread streams, see global_rng()).
+     *
+     * A single instance is NOT thread-safe; give every worker its own stream.
+     */
+    class Xoshiro256 final {
+    public:
+        using result_type = uint64_t;
+
+        static constexpr result_type min() noexcept { return 0; }
+
+        static constexpr result_type max() noexcept { return std::numeric_limits<result_type>::max(); }
+
+        explicit Xoshiro256(const uint64_t seed_value = 0) noexcept {
+            seed(seed_value);
+        }
+
+        void seed(uint64_t seed_value) noexcept {
+            for (auto &word: s) {
+                // splitmix64, never yields an all-zero state
+                seed_value += 0x9E3779B97F4A7C15ULL;
+                uint64_t z = seed_value;
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                word = z ^ (z >> 31);
+            }
+        }
+
+        result_type operator()() noexcept {
+            const uint64_t result = rotl(s[1] * 5, 7) * 9;
+            const uint64_t t = s[1] << 17;
+
+            s[2] ^= s[0];
+            s[3] ^= s[1];
+            s[1] ^= s[2];
+            s[0] ^= s[3];
+            s[2] ^= t;
+            s[3] = rotl(s[3], 45);
+
+            return result;
+        }
+
+        /// Advance by 2^128 draws.
+        void jump() noexcept {
+            static constexpr uint64_t JUMP[] = {
+                    0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL,
+                    0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL};
+            apply_jump(JUMP);
+        }
+
+        /// Advance by 2^192 draws.
+        void long_jump() noexcept {
+            static constexpr uint64_t LONG_JUMP[] = {
+                    0x76E15D3EFEFDCBBFULL, 0xC5004E441C522FB3ULL,
+                    0x77710069854EE241ULL, 0x39109BB02ACBE635ULL};
+            apply_jump(LONG_JUMP);
+        }
+
+        /**
+         * @brief Hand out the current stream and move this one 2^128 draws ahead.
+         * @return An independent generator; calling split() k times yields k non-overlapping workers.
+         */
+        [[nodiscard]] Xoshiro256 split() noexcept {
+            Xoshiro256 child = *this;
+            jump();
+            return child;
+        }
+
+    private:
+        uint64_t s[4]{};
+
+        static constexpr uint64_t rotl(const uint64_t x, const int k) noexcept {
+            return (x << k) | (x >> (64 - k));
+        }
+
+        void apply_jump(const uint64_t (&table)[4]) noexcept {
+            uint64_t acc[4]{};
+            for (const uint64_t word: table) {
+                for (int b = 0; b < 64; ++b) {
+                    if (word & (uint64_t{1} << b)) {
+                        acc[0] ^= s[0];
+                        acc[1] ^= s[1];
+                        acc[2] ^= s[2];
+                        acc[3] ^= s[3];
+                    }
+                    (*this)();
+                }
+            }
+            s[0] = acc[0];
+            s[1] = acc[1];
+            s[2] = acc[2];
+            s[3] = acc[3];
+        }
+    };
+
+    using rng_engine = Xoshiro256;
+
+} // namespace fabric
+
+/// @brief Per-thread generator; each thread receives its own long-jumped stream of a process-wide root.
+extern fabric::rng_engine &global_rng();
@@ -0,0 +1,237 @@
+/// Copyright (c) 2025 bulgogi-framework
+/// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <boost/beast/http.hpp>
+#include <boost/json.hpp>
+#include "async.hpp"
+#include "marcos.hpp"
+#include "metrics.hpp"
+
+
+namespace bulgogi {
+
+    /// Limits of the admission gate; compile-time defaults from marcos.hpp, each overridable by the
+    /// environment variable of the same name.
+    struct AdmissionConfig {
+        size_t max_in_flight;   /// views running at once, the size of blocking_pool()
+        size_t max_queue;       /// admitted views waiting for a free handler thread
+        uint32_t retry_after;   /// seconds, sent with every 503
+        std::unordered_map<std::string, size_t> route_limits; /// route (no leading '/') -> admitted at once
+
+        static AdmissionConfig from_env() {
+            AdmissionConfig config{};
+            config.max_in_flight = handler_threads();
+            config.max_queue = env_or("ADMISSION_MAX_QUEUE", ADMISSION_MAX_QUEUE);
+            config.retry_after = static_cast<uint32_t>(env_or("ADMISSION_RETRY_AFTER", ADMISSION_RETRY_AFTER));
+
+            const char *routes = std::getenv("ADMISSION_ROUTE_LIMITS");
+            config.route_limits = parse_route_limits(routes ? routes : ADMISSION_ROUTE_LIMITS);
+            return config;
+        }
+
+        /// "api/simulate_day=1,api/refresh_db=1" -> {route: limit}; malformed entries are skipped.
+        static std::unordered_map<std::string, size_t> parse_route_limits(std::string_view spec) {
+            std::unordered_map<std::string, size_t> limits;
+            while (!spec.empty()) {
+                const size_t comma = spec.find(',');
+                std::string_view entry = spec.substr(0, comma);
+                spec.remove_prefix(comma == std::string_view::npos ? spec.size() : comma + 1);
+
+                while (!entry.empty() && entry.front() == ' ') entry.remove_prefix(1);
+                while (!entry.empty() && entry.back() == ' ') entry.remove_suffix(1);
+                if (!entry.empty() && entry.front() == '/') entry.remove_prefix(1);
+
+                const size_t eq = entry.find('=');
+                if (eq == std::string_view::npos || eq == 0) continue;
+                size_t limit = 0;
+                const auto value = entry.substr(eq + 1);
+                const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), limit);
+                if (ec != std::errc{} || end != value.data() + value.size() || limit == 0) continue;
+                limits[std::string(entry.substr(0, eq))] = limit;
+            }
+            return limits;
+        }
+    };
+
+    /**
+     * @brief Load shedding in front of blocking_pool().
+     *
+     * Only work headed for the pool is counted: sync views right before they are offloaded, coroutine
+     * views when they call admitted_offload. Preflights, unknown paths and coroutine views that never
+     * block are not, so monitoring keeps answering under overload. A request is admitted while fewer
+     * than max_in_flight + max_queue are admitted overall and its route is below its own cap; otherwise
+     * it is answered 503 right away on the io thread, before it can queue behind the single MySQL
+     * connection. Counting is lock-free: optimistic increment, undone when over the limit.
+     */
+    class Admission final {
+        /// Lets per_route be searched with the request's string_view.
+        struct RouteHash {
+            using is_transparent = void;
+
+            size_t operator()(const std::string_view route) const noexcept {
+                return std::hash<std::string_view>{}(route);
+            }
+        };
+
+    public:
+        enum class Verdict : uint8_t {
+            admitted,
+            overloaded,  /// server-wide limit
+            route_busy   /// the route's own cap
+        };
+
+        /// Holds one admitted slot (and its route slot) until destroyed.
+        class Ticket final {
+        public:
+            Ticket(Ticket &&other) noexcept: owner(std::exchange(other.owner, nullptr)),
+                                             route(std::exchange(other.route, nullptr)) {}
+
+            Ticket(const Ticket &) = delete;
+
+            Ticket &operator=(const Ticket &) = delete;
+
+            Ticket &operator=(Ticket &&) = delete;
+
+            ~Ticket() {
+                if (route) route->fetch_sub(1, std::memory_order_relaxed);
+                if (owner) owner->admitted.fetch_sub(1, std::memory_order_relaxed);
+            }
+
+        private:
+            friend class Admission;
+
+            Ticket(Admission *owner, std::atomic<size_t> *route) : owner(owner), route(route) {}
+
+            Admission *owner;
+            std::atomic<size_t> *route;
+        };
+
+        explicit Admission(AdmissionConfig config) : settings(std::move(config)) {
+            for (const auto &[route, _]: settings.route_limits) {
+                per_route.emplace(route, std::make_unique<std::atomic<size_t>>(0));
+            }
+        }
+
+        /// @param route Request path without the query, with or without the leading '/'.
+        std::optional<Ticket> try_admit(std::string_view route, Verdict &verdict) {
+            if (!route.empty() && route.front() == '/') route.remove_prefix(1);
+
+            const size_t limit = settings.max_in_flight + settings.max_queue;
+            if (admitted.fetch_add(1, std::memory_order_relaxed) >= limit) {
+                admitted.fetch_sub(1, std::memory_order_relaxed);
+                rejected_overloaded.fetch_add(1, std::memory_order_relaxed);
+                verdict = Verdict::overloaded;
+                return std::nullopt;
+            }
+
+            std::atomic<size_t> *route_count = nullptr;
+            if (const auto it = per_route.find(route); it != per_route.end()) {
+                route_count = it->second.get();
+                if (route_count->fetch_add(1, std::memory_order_relaxed) >= settings.route_limits.at(it->first)) {
+                    route_count->fetch_sub(1, std::memory_order_relaxed);
+                    admitted.fetch_sub(1, std::memory_order_relaxed);
+                    rejected_route.fetch_add(1, std::memory_order_relaxed);
+                    verdict = Verdict::route_busy;
+                    return std::nullopt;
+                }
+            }
+
+            verdict = Verdict::admitted;
+            return Ticket(this, route_count);
+        }
+
+        [[nodiscard]] const AdmissionConfig &config() const noexcept { return settings; }
+
+        [[nodiscard]] boost::json::object to_json() const {
+            const size_t now = admitted.load(std::memory_order_relaxed);
+            const size_t running = std::min(now, settings.max_in_flight);
+
+            boost::json::object obj;
+            obj["in_flight"] = running;
+            obj["queued"] = now - running;
+            obj["max_in_flight"] = settings.max_in_flight;
+            obj["max_queue"] = settings.max_queue;
+            obj["rejected_overloaded"] = rejected_overloaded.load(std::memory_order_relaxed);
+            obj["rejected_route_busy"] = rejected_route.load(std::memory_order_relaxed);
+
+            boost::json::object routes;
+            for (const auto &[route, count]: per_route) {
+                boost::json::object item;
+                item["admitted"] = count->load(std::memory_order_relaxed);
+                item["limit"] = settings.route_limits.at(route);
+                routes[route] = item;
+            }
+            obj["routes"] = routes;
+            return obj;
+        }
+
+        void write_prometheus(std::string &out) const {
+            const size_t now = admitted.load(std::memory_order_relaxed);
+            const size_t running = std::min(now, settings.max_in_flight);
+
+            prometheus_family(out, "bulgogi_requests_in_flight", "gauge", "Admitted requests running a view.");
+            prometheus_sample(out, "bulgogi_requests_in_flight", "", running);
+            prometheus_family(out, "bulgogi_requests_queued", "gauge", "Admitted requests waiting for a handler thread.");
+            prometheus_sample(out, "bulgogi_requests_queued", "", now - running);
+            prometheus_family(out, "bulgogi_requests_shed_total", "counter", "Requests answered 503 by the admission gate.");
+            prometheus_sample(out, "bulgogi_requests_shed_total", "reason=\"overloaded\"",
+                              rejected_overloaded.load(std::memory_order_relaxed));
+            prometheus_sample(out, "bulgogi_requests_shed_total", "reason=\"route_busy\"",
+                              rejected_route.load(std::memory_order_relaxed));
+        }
+
+    private:
+        const AdmissionConfig settings;
+        std::atomic<size_t> admitted{0};
+        std::unordered_map<std::string, std::unique_ptr<std::atomic<size_t>>, RouteHash, std::equal_to<>> per_route; /// keys fixed at construction
+        std::atomic<uint64_t> rejected_overloaded{0};
+        std::atomic<uint64_t> rejected_route{0};
+    };
+
+    /// The server's admission gate, configured on first use.
+    inline Admission &admission() {
+        static Admission gate(AdmissionConfig::from_env());
+        return gate;
+    }
+
+    /**
+     * @brief Thrown by admitted_offload when the gate turns the work away; the server answers 503.
+     *
+     * Deliberately not a std::exception: a view's `catch (const std::exception &)` for its own errors
+     * lets it through to the server.
+     */
+    struct Shed {
+        Admission::Verdict verdict;
+    };
+
+    /**
+     * @brief offload for coroutine views: admitted like a sync view of the same route, held until @p f returns.
+     * @throws Shed if the server or the route is at its limit.
+     */
+    template<typename F>
+    net::awaitable<std::invoke_result_t<F &>> admitted_offload(const boost::beast::http::request<boost::beast::http::string_body> &req,
+                                                                F f) {
+        std::string_view route(req.target().data(), req.target().size());
+        route = route.substr(0, route.find('?'));
+
+        Admission::Verdict verdict{};
+        const auto ticket = admission().try_admit(route, verdict);
+        if (!ticket) throw Shed{verdict};
+        co_return co_await offload(std::move(f));
+    }
+
+}
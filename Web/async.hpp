@@ -0,0 +1,100 @@
+/// Copyright (c) 2025 bulgogi-framework
+/// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include "marcos.hpp"
+
+
+namespace bulgogi {
+    namespace net = boost::asio;
+
+    /// Numeric setting @p name from the environment, @p fallback (the compile-time default) if unset or malformed.
+    inline size_t env_or(const char *name, const size_t fallback) {
+        const char *value = std::getenv(name);
+        if (!value || !*value) return fallback;
+        size_t parsed = 0;
+        const auto [end, ec] = std::from_chars(value, value + std::strlen(value), parsed);
+        return ec == std::errc{} && *end == '\0' ? parsed : fallback;
+    }
+
+    /// Threads of blocking_pool(): HANDLER_THREADS, overridable by the environment variable of the same name.
+    inline size_t handler_threads() {
+        static const size_t threads = std::max<size_t>(env_or("HANDLER_THREADS", HANDLER_THREADS), 1);
+        return threads;
+    }
+
+    /**
+     * @brief The fixed pool blocking view code runs on (database calls, graph searches).
+     *
+     * Kept apart from the io threads, so a slow handler never stalls accepting or reading other
+     * connections. Sized by handler_threads().
+     */
+    inline net::thread_pool &blocking_pool() {
+        static net::thread_pool pool(handler_threads());
+        return pool;
+    }
+
+    /**
+     * @brief Run @p f on blocking_pool() and resume the awaiting coroutine on its own executor.
+     *
+     * Exceptions thrown by @p f are rethrown at the co_await.
+     * @code
+     * bulgogi::Response res = co_await bulgogi::offload([&] { return load_something(); });
+     * @endcode
+     */
+    template<typename F>
+    net::awaitable<std::invoke_result_t<F &>> offload(F f) {
+        using R = std::invoke_result_t<F &>;
+
+        if constexpr (std::is_void_v<R>) {
+            co_await net::async_initiate<const net::use_awaitable_t<>, void(std::exception_ptr)>(
+                    [](auto handler, F fn) {
+                        net::post(blocking_pool(), [handler = std::move(handler), fn = std::move(fn)]() mutable {
+                            std::exception_ptr error;
+                            try {
+                                fn();
+                            } catch (...) {
+                                error = std::current_exception();
+                            }
+                            auto executor = net::get_associated_executor(handler);
+                            net::dispatch(executor, [handler = std::move(handler), error]() mutable {
+                                handler(error);
+                            });
+                        });
+                    }, net::use_awaitable, std::move(f));
+        } else {
+            co_return co_await net::async_initiate<const net::use_awaitable_t<>, void(std::exception_ptr, R)>(
+                    [](auto handler, F fn) {
+                        net::post(blocking_pool(), [handler = std::move(handler), fn = std::move(fn)]() mutable {
+                            std::exception_ptr error;
+                            std::optional<R> result;
+                            try {
+                                result.emplace(fn());
+                            } catch (...) {
+                                error = std::current_exception();
+                            }
+                            auto executor = net::get_associated_executor(handler);
+                            net::dispatch(executor, [handler = std::move(handler), error,
+                                    result = std::move(result)]() mutable {
+                                handler(error, result ? std::move(*result) : R{});
+                            });
+                        });
+                    }, net::use_awaitable, std::move(f));
+        }
+    }
+
+}
@@ -3,10 +3,21 @@
 
 #pragma once
 
+#include <charconv>
+#include <cmath>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
 #include <boost/beast/http.hpp>
 #include <boost/json.hpp>
 #include <jh/pod>
 #include "marcos.hpp"
+#include "query.hpp"
 
 
 namespace bulgogi {
@@ -46,6 +57,248 @@ namespace bulgogi {
         res.prepare_payload();
     }
 
+    /**
+     * @brief Streaming JSON writer appending straight to a string, normally the response body.
+     *
+     * No DOM and no temporary string: numbers go through std::to_chars into the buffer, commas are
+     * placed from a per-depth bit (nesting up to 64 levels). The caller is responsible for balanced
+     * begin/end calls and for a key before every value inside an object.
+     * @code
+     * bulgogi::write_json(res, [&](bulgogi::JsonWriter &json) {
+     *     json.begin_object().key("friends").begin_array();
+     *     for (uint32_t id: friends) json.value(id);
+     *     json.end_array().end_object();
+     * });
+     * @endcode
+     */
+    class JsonWriter final {
+    public:
+        explicit JsonWriter(std::string &out, const size_t reserve = 0) : out(out) {
+            out.clear();
+            out.reserve(reserve);
+        }
+
+        JsonWriter &begin_object() { return open('{'); }
+
+        JsonWriter &end_object() { return close('}'); }
+
+        JsonWriter &begin_array() { return open('['); }
+
+        JsonWriter &end_array() { return close(']'); }
+
+        JsonWriter &key(const std::string_view name) {
+            separate();
+            quoted(name);
+            out += ':';
+            after_key = true;
+            return *this;
+        }
+
+        template<typename T> requires std::is_integral_v<T> && (!std::is_same_v<T, bool>)
+        JsonWriter &value(const T number) {
+            separate();
+            char buf[24];
+            const auto [end, _] = std::to_chars(buf, buf + sizeof(buf), number);
+            out.append(buf, end);
+            return *this;
+        }
+
+        JsonWriter &value(const double number) {
+            separate();
+            if (!std::isfinite(number)) {
+                out += "null"; // JSON has no NaN / Infinity
+                return *this;
+            }
+            char buf[32];
+            const auto [end, _] = std::to_chars(buf, buf + sizeof(buf), number);
+            out.append(buf, end);
+            return *this;
+        }
+
+        JsonWriter &value(const bool flag) {
+            separate();
+            out += flag ? "true" : "false";
+            return *this;
+        }
+
+        JsonWriter &value(const std::string_view text) {
+            separate();
+            quoted(text);
+            return *this;
+        }
+
+        JsonWriter &value(const char *text) { return value(std::string_view(text)); }
+
+        JsonWriter &value(std::nullptr_t) {
+            separate();
+            out += "null";
+            return *this;
+        }
+
+        /// Already serialized JSON, e.g. from boost::json::serialize for a rarely used sub-object.
+        JsonWriter &raw(const std::string_view json) {
+            separate();
+            out += json;
+            return *this;
+        }
+
+    private:
+        std::string &out;
+        uint64_t has_items = 0;  /// bit d: the container at depth d already holds an element
+        uint32_t depth = 0;
+        bool after_key = false;
+
+        void separate() {
+            if (after_key) {
+                after_key = false;
+                return;
+            }
+            if (depth == 0) return;
+            const uint64_t bit = uint64_t{1} << (depth - 1);
+            if (has_items & bit) out += ',';
+            has_items |= bit;
+        }
+
+        JsonWriter &open(const char bracket) {
+            separate();
+            out += bracket;
+            ++depth;
+            has_items &= ~(uint64_t{1} << (depth - 1));
+            return *this;
+        }
+
+        JsonWriter &close(const char bracket) {
+            --depth;
+            out += bracket;
+            return *this;
+        }
+
+        void quoted(const std::string_view text) {
+            static constexpr char HEX[] = "0123456789abcdef";
+            out += '"';
+            for (const char c: text) {
+                switch (c) {
+                    case '"':
+                        out += "\\\"";
+                        break;
+                    case '\\':
+                        out += "\\\\";
+                        break;
+                    case '\n':
+                        out += "\\n";
+                        break;
+                    case '\r':
+                        out += "\\r";
+                        break;
+                    case '\t':
+                        out += "\\t";
+                        break;
+                    default:
+                        if (static_cast<unsigned char>(c) < 0x20) {
+                            out += "\\u00";
+                            out += HEX[static_cast<unsigned char>(c) >> 4];
+                            out += HEX[static_cast<unsigned char>(c) & 0xF];
+                        } else {
+                            out += c;
+                        }
+                }
+            }
+            out += '"';
+        }
+    };
+
+    /**
+     * @brief Set response as JSON written by @p fill through a JsonWriter on the body itself.
+     * @param res Response to populate.
+     * @param fill Callable taking JsonWriter&.
+     * @param status_code HTTP status code (default: 200).
+     * @param reserve Bytes to reserve up front, the expected body size.
+     */
+    template<typename F>
+    void write_json(Response &res, F &&fill, int status_code = 200, size_t reserve = 256) {
+        res.result(http::status(status_code));
+        res.set(http::field::content_type, "application/json");
+        JsonWriter json(res.body(), reserve);
+        std::forward<F>(fill)(json);
+        res.prepare_payload();
+    }
+
+    /// Media type of the binary id list written by set_id_list.
+    inline constexpr std::string_view ID_LIST_MIME = "application/octet-stream";
+
+    /**
+     * @brief Whether the client's Accept header prefers ID_LIST_MIME over JSON.
+     *
+     * Only an explicit application/octet-stream selects binary; wildcards count for JSON, the default.
+     * q-values are honoured and a tie goes to JSON.
+     */
+    [[nodiscard]] inline bool accepts_id_list(const Request &req) {
+        const auto header = req[http::field::accept];
+        std::string_view accept(header.data(), header.size());
+        double binary_q = 0, json_q = 0;
+
+        while (!accept.empty()) {
+            const size_t comma = accept.find(',');
+            std::string_view range = accept.substr(0, comma);
+            accept.remove_prefix(comma == std::string_view::npos ? accept.size() : comma + 1);
+
+            double q = 1;
+            if (const size_t semi = range.find(';'); semi != std::string_view::npos) {
+                if (const size_t qpos = range.find("q=", semi); qpos != std::string_view::npos) {
+                    const auto value = range.substr(qpos + 2);
+                    std::from_chars(value.data(), value.data() + value.size(), q);
+                }
+                range = range.substr(0, semi);
+            }
+            while (!range.empty() && range.front() == ' ') range.remove_prefix(1);
+            while (!range.empty() && range.back() == ' ') range.remove_suffix(1);
+
+            if (range == ID_LIST_MIME) binary_q = std::max(binary_q, q);
+            else if (range == "application/json" || range == "application/*" || range == "*/*") json_q = std::max(json_q, q);
+        }
+        return binary_q > json_q;
+    }
+
+    /**
+     * @brief Set response as a binary id list (ID_LIST_MIME), everything little-endian:
+     *        the magic "BGID", a uint32 count, then count uint32 ids.
+     *
+     * The ids are copied into the body with a single memcpy on little-endian hosts.
+     * @param res Response to populate.
+     * @param ids Contiguous ids, e.g. the filled part of a pod::array.
+     * @param status_code HTTP status code (default: 200).
+     */
+    inline void set_id_list(Response &res, const std::span<const uint32_t> ids, int status_code = 200) {
+        static constexpr char MAGIC[4] = {'B', 'G', 'I', 'D'};
+        const auto to_le = [](uint32_t v) {
+            if constexpr (std::endian::native == std::endian::big) {
+                v = (v >> 24) | ((v >> 8) & 0xFF00u) | ((v << 8) & 0xFF0000u) | (v << 24);
+            }
+            return v;
+        };
+
+        res.result(http::status(status_code));
+        res.set(http::field::content_type, ID_LIST_MIME);
+
+        auto &body = res.body();
+        body.resize(sizeof(MAGIC) + sizeof(uint32_t) * (1 + ids.size()));
+        char *out = body.data();
+        std::memcpy(out, MAGIC, sizeof(MAGIC));
+        const uint32_t count = to_le(static_cast<uint32_t>(ids.size()));
+        std::memcpy(out + sizeof(MAGIC), &count, sizeof(count));
+        out += sizeof(MAGIC) + sizeof(count);
+        if constexpr (std::endian::native == std::endian::little) {
+            if (!ids.empty()) std::memcpy(out, ids.data(), ids.size_bytes());
+        } else {
+            for (const uint32_t id: ids) {
+                const uint32_t le = to_le(id);
+                std::memcpy(out, &le, sizeof(le));
+                out += sizeof(le);
+            }
+        }
+        res.prepare_payload();
+    }
+
     /**
      * @brief Set response as plain text body.
      * @param res Response to populate.
@@ -159,6 +412,118 @@ namespace bulgogi {
         res.prepare_payload();
     }
 
+    /// Suffixes compress_response appends inside an ETag it re-encodes, "\"3f-7\"" -> "\"3f-7-gzip\"".
+    inline constexpr std::string_view ETAG_CODING_SUFFIXES[] = {"-gzip", "-deflate"};
+
+    /**
+     * @brief The entity tag of @p req's If-None-Match that matches @p etag, empty if none does.
+     *
+     * `*` matches anything. Comparison is weak (a W/ prefix is ignored), as RFC 9110 asks for
+     * If-None-Match, and a coding suffix from compress_response is stripped first: the compressed
+     * copy a client holds has the same content.
+     */
+    [[nodiscard]] inline std::string_view match_etag(const Request &req, const std::string_view etag) {
+        const auto same = [etag](const std::string_view opaque) {
+            if (opaque == etag) return true;
+            for (const std::string_view suffix: ETAG_CODING_SUFFIXES) {
+                // "<etag body><suffix>"
+                if (opaque.size() == etag.size() + suffix.size() &&
+                    opaque.substr(0, etag.size() - 1) == etag.substr(0, etag.size() - 1) &&
+                    opaque.substr(etag.size() - 1, suffix.size()) == suffix && opaque.back() == '"') {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        for (auto [it, end] = req.equal_range(http::field::if_none_match); it != end; ++it) {
+            std::string_view list(it->value().data(), it->value().size());
+            while (true) {
+                const size_t start = list.find_first_not_of(" \t,");
+                if (start == std::string_view::npos) break;
+                list.remove_prefix(start);
+                if (list.front() == '*') return list.substr(0, 1);
+
+                const size_t open = list.starts_with("W/") ? 2 : 0;
+                const size_t close = list.find('"', open + 1);
+                if (list.size() <= open || list[open] != '"' || close == std::string_view::npos) break; // malformed
+                const std::string_view tag = list.substr(0, close + 1);
+                list.remove_prefix(close + 1);
+
+                if (same(tag.substr(open))) return tag;
+            }
+        }
+        return {};
+    }
+
+    /**
+     * @brief Tag a 200 with the strong @p etag; no-cache makes clients revalidate with it every time.
+     * @param etag Quoted, e.g. "\"3f-7\"".
+     */
+    inline void set_etag(Response &res, const std::string_view etag) {
+        res.set(http::field::etag, etag);
+        res.set(http::field::cache_control, "no-cache");
+    }
+
+    /**
+     * @brief Conditional GET: answer 304 Not Modified when @p req already holds @p etag.
+     *
+     * Call before any expensive work. The 304 carries the tag the client sent, so a cache freshens
+     * the (possibly compressed) variant it stored.
+     * @return true if the 304 is set and the view is done.
+     */
+    inline bool set_not_modified(const Request &req, Response &res, const std::string_view etag) {
+        std::string_view held = match_etag(req, etag);
+        if (held.empty()) return false;
+        if (held == "*") held = etag;
+
+        res.result(http::status::not_modified);
+        set_etag(res, held);
+        res.body().clear();
+        // No body, and no Content-Length: 0 a cache could copy onto the stored response
+        res.content_length(boost::none);
+        res.chunked(false);
+        return true;
+    }
+
+    /// The verb list of a view, rendered for the 405 body and for Access-Control-Allow-Methods.
+    struct MethodStrings {
+        std::string expected;   /// "GET, POST"
+        std::string allow;      /// "GET, POST, OPTIONS"
+    };
+
+    /**
+     * @brief MethodStrings of @p methods, rendered once per thread and verb list.
+     *
+     * Views call check_method on every request with the same few lists; the key packs up to eight
+     * verbs (order kept), longer lists are rendered into a per-thread scratch entry each time.
+     */
+    inline const MethodStrings &method_strings(std::initializer_list<http::verb> methods) {
+        const auto render = [&methods](MethodStrings &out) {
+            out.expected.clear();
+            for (auto it = methods.begin(); it != methods.end(); ++it) {
+                if (it != methods.begin()) out.expected += ", ";
+                out.expected += http::to_string(*it);
+            }
+            out.allow = out.expected;
+            if (!out.allow.empty()) out.allow += ", ";
+            out.allow += http::to_string(http::verb::options);  // preflight
+        };
+
+        thread_local std::unordered_map<uint64_t, MethodStrings> cache;
+        if (methods.size() > 8) {
+            thread_local MethodStrings scratch;
+            render(scratch);
+            return scratch;
+        }
+
+        uint64_t key = 0;
+        for (const http::verb v: methods) key = key << 8 | (static_cast<uint64_t>(v) + 1);
+        const auto [it, inserted] = cache.try_emplace(key);
+        if (inserted) render(it->second);
+        return it->second;
+    }
+
     /**
      * @brief Set CORS headers for response.
      * @param res Response to modify.
@@ -172,14 +537,7 @@ namespace bulgogi {
         res.set(http::field::access_control_allow_origin, allow_origin);
 
         if (allowed_methods.size()) {
-            std::ostringstream oss;
-            for (auto it = allowed_methods.begin(); it != allowed_methods.end(); ++it) {
-                oss << http::to_string(*it);
-                if (std::next(it) != allowed_methods.end()) oss << ", ";
-            }
-            oss << ", " << http::to_string(http::verb::options);  // preflight
-
-            res.set(http::field::access_control_allow_methods, oss.str());
+            res.set(http::field::access_control_allow_methods, method_strings(allowed_methods).allow);
         }
 
         res.set(http::field::access_control_allow_headers, "Content-Type, Authorization");
@@ -224,14 +582,7 @@ namespace bulgogi {
         if (!allowed) {
             set_json(res, {
                     {"error",    "Method Not Allowed"},
-                    {"expected", [allowed_methods]{
-                        std::ostringstream oss;
-                        for (auto it = allowed_methods.begin(); it != allowed_methods.end(); ++it) {
-                            oss << http::to_string(*it);
-                            if (std::next(it) != allowed_methods.end()) oss << ", ";
-                        }
-                        return oss.str();
-                    }()},
+                    {"expected", method_strings(allowed_methods).expected},
                     {"got", http::to_string(req_method)}
             }, 405);
 
@@ -265,33 +616,16 @@ namespace bulgogi {
      * @brief Extract query string parameter from URL.
      * @param req HTTP request with URL.
      * @param key Name of the query parameter.
-     * @return Value if key exists; std::nullopt otherwise.
+     * @return Decoded value if key exists; std::nullopt otherwise.
+     * @note Parses the whole query on every call; a view reading several parameters should build
+     *       one bulgogi::Query and read them from it.
      */
     [[maybe_unused]] inline std::optional<std::string> get_query_param(
             const boost::beast::http::request<boost::beast::http::string_body> &req,
             std::string_view key) {
-        const std::string target = std::string(req.target());
-        const std::string_view target_view = target;
-        std::string_view query = target_view.substr(target.find('?') + 1); // query = view from owned string
-
-        while (!query.empty()) {
-            auto eq = query.find('=');
-            if (eq == std::string_view::npos) break;
-
-            std::string_view k = query.substr(0, eq);
-            query.remove_prefix(eq + 1);
-
-            auto amp = query.find('&');
-            std::string_view v = (amp == std::string_view::npos) ? query : query.substr(0, amp);
-            if (amp != std::string_view::npos) query.remove_prefix(amp + 1);
-            else query = {};
-
-            if (k == key) {
-                return std::string(v); // NOLINT(clang-analyzer-cplusplus.NewDeleteLeaks)
-                // safe: v from target_view, local variable
-            }
-        }
-        return std::nullopt;
+        const auto value = Query(req).text(key);
+        if (!value) return std::nullopt;
+        return std::string(*value);
     }
 
 }
@@ -0,0 +1,146 @@
+/// Copyright (c) 2025 bulgogi-framework
+/// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <zlib.h>
+#include "bulgogi.hpp"
+#include "marcos.hpp"
+
+
+namespace bulgogi {
+
+    enum class Encoding : uint8_t {
+        identity,
+        gzip,
+        deflate   /// zlib stream (RFC 1950), what HTTP calls deflate
+    };
+
+    /**
+     * @brief The Content-Encoding to answer @p req with, from its Accept-Encoding.
+     *
+     * q-values are honoured, q=0 refuses a coding; on a tie gzip wins over deflate. `*` stands for gzip.
+     */
+    [[nodiscard]] inline Encoding negotiate_encoding(const Request &req) {
+        const auto header = req[http::field::accept_encoding];
+        std::string_view accept(header.data(), header.size());
+        double deflate_q = 0, any_q = -1, explicit_gzip = -1;
+
+        while (!accept.empty()) {
+            const size_t comma = accept.find(',');
+            std::string_view coding = accept.substr(0, comma);
+            accept.remove_prefix(comma == std::string_view::npos ? accept.size() : comma + 1);
+
+            double q = 1;
+            if (const size_t semi = coding.find(';'); semi != std::string_view::npos) {
+                if (const size_t qpos = coding.find("q=", semi); qpos != std::string_view::npos) {
+                    const auto value = coding.substr(qpos + 2);
+                    std::from_chars(value.data(), value.data() + value.size(), q);
+                }
+                coding = coding.substr(0, semi);
+            }
+            while (!coding.empty() && coding.front() == ' ') coding.remove_prefix(1);
+            while (!coding.empty() && coding.back() == ' ') coding.remove_suffix(1);
+
+            if (coding == "gzip" || coding == "x-gzip") explicit_gzip = std::max(explicit_gzip, q);
+            else if (coding == "deflate") deflate_q = std::max(deflate_q, q);
+            else if (coding == "*") any_q = std::max(any_q, q);
+        }
+
+        const double gzip_q = explicit_gzip >= 0 ? explicit_gzip : std::max(any_q, 0.0);
+        if (gzip_q > 0 && gzip_q >= deflate_q) return Encoding::gzip;
+        if (deflate_q > 0) return Encoding::deflate;
+        return Encoding::identity;
+    }
+
+    /**
+     * @brief One zlib compressor, kept for the lifetime of its thread and reset between responses.
+     *
+     * deflateInit2 allocates about 256 KiB of state; resetting instead of re-initialising keeps that
+     * out of the request path.
+     */
+    class Deflater final {
+    public:
+        explicit Deflater(const Encoding encoding) {
+            // windowBits 15 + 16 writes a gzip wrapper, 15 alone a zlib one
+            const int window_bits = encoding == Encoding::gzip ? 15 + 16 : 15;
+            if (deflateInit2(&stream, COMPRESS_LEVEL, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                throw std::runtime_error("deflateInit2 failed");
+            }
+        }
+
+        Deflater(const Deflater &) = delete;
+
+        Deflater &operator=(const Deflater &) = delete;
+
+        ~Deflater() { deflateEnd(&stream); }
+
+        /// Compress all of @p in into @p out (overwritten), @return false on a zlib error.
+        bool compress(const std::string_view in, std::string &out) {
+            deflateReset(&stream);
+            out.resize(deflateBound(&stream, static_cast<uLong>(in.size())));
+
+            stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+            stream.avail_in = static_cast<uInt>(in.size());
+            stream.next_out = reinterpret_cast<Bytef *>(out.data());
+            stream.avail_out = static_cast<uInt>(out.size());
+
+            // deflateBound leaves room for everything, one call finishes the stream
+            if (deflate(&stream, Z_FINISH) != Z_STREAM_END) return false;
+            out.resize(stream.total_out);
+            return true;
+        }
+
+    private:
+        z_stream stream{};
+    };
+
+    /**
+     * @brief Compress @p res's body in place when @p req accepts it and the body is worth it.
+     *
+     * Bodies under COMPRESS_MIN_BYTES, responses already encoded and results that would not shrink
+     * are left alone. Anything large enough gets `Vary: Accept-Encoding`, compressed or not, so caches
+     * keep the variants apart. The compressors and the output buffer are per thread and reused.
+     */
+    inline void compress_response(const Request &req, Response &res) {
+        static constexpr size_t SCRATCH_KEEP_BYTES = size_t{4} << 20; // one bulk export must not pin memory
+
+        if (res.body().size() < COMPRESS_MIN_BYTES || res.count(http::field::content_encoding)) return;
+        if (req.method() == http::verb::head) return;
+
+        if (const auto vary = res[http::field::vary]; vary.empty()) {
+            res.set(http::field::vary, "Accept-Encoding");
+        } else {
+            res.set(http::field::vary, std::string(vary.data(), vary.size()) + ", Accept-Encoding");
+        }
+
+        const Encoding encoding = negotiate_encoding(req);
+        if (encoding == Encoding::identity) return;
+
+        thread_local Deflater gzip(Encoding::gzip);
+        thread_local Deflater zlib(Encoding::deflate);
+        thread_local std::string scratch;
+
+        Deflater &deflater = encoding == Encoding::gzip ? gzip : zlib;
+        if (!deflater.compress(res.body(), scratch) || scratch.size() >= res.body().size()) return;
+
+        res.body().swap(scratch); // scratch keeps the old body's capacity for the next response
+        if (scratch.capacity() > SCRATCH_KEEP_BYTES) std::string().swap(scratch);
+        res.set(http::field::content_encoding, encoding == Encoding::gzip ? "gzip" : "deflate");
+        // Other bytes, other strong tag; match_etag strips the suffix again
+        if (const auto etag = res[http::field::etag]; etag.size() >= 2 && etag.back() == '"') {
+            std::string tagged(etag.data(), etag.size() - 1);
+            tagged += ETAG_CODING_SUFFIXES[encoding == Encoding::gzip ? 0 : 1];
+            tagged += '"';
+            res.set(http::field::etag, tagged);
+        }
+        res.prepare_payload();
+    }
+
+}
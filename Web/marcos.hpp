@@ -37,3 +37,43 @@
 #ifndef CORS_MAX_AGE
 #define CORS_MAX_AGE 86400
 #endif
+
+#ifndef BODY_LIMIT
+#define BODY_LIMIT 16777216
+#endif
+
+#ifndef IO_THREADS
+#define IO_THREADS 0 // 0 = one per hardware thread
+#endif
+
+#ifndef HANDLER_THREADS
+#define HANDLER_THREADS 8
+#endif
+
+#ifndef KEEP_ALIVE_TIMEOUT
+#define KEEP_ALIVE_TIMEOUT 5 // seconds a kept-alive connection may sit idle
+#endif
+
+#ifndef KEEP_ALIVE_MAX
+#define KEEP_ALIVE_MAX 1000 // requests per connection before the server closes it
+#endif
+
+#ifndef ADMISSION_MAX_QUEUE
+#define ADMISSION_MAX_QUEUE 256 // admitted requests waiting for a handler thread
+#endif
+
+#ifndef ADMISSION_RETRY_AFTER
+#define ADMISSION_RETRY_AFTER 1 // seconds, Retry-After of a shed request
+#endif
+
+#ifndef ADMISSION_ROUTE_LIMITS // route=limit,... requests of a route admitted at once
+#define ADMISSION_ROUTE_LIMITS "api/simulate_day=1,api/simulate_days=1,api/refresh_db=1,api/set_db_connection=1,api/batch_recommend_fof=2"
+#endif
+
+#ifndef COMPRESS_MIN_BYTES
+#define COMPRESS_MIN_BYTES 1024 // smaller bodies are sent uncompressed
+#endif
+
+#ifndef COMPRESS_LEVEL
+#define COMPRESS_LEVEL 6 // zlib level, 1 (fastest) .. 9 (smallest)
+#endif
@@ -0,0 +1,376 @@
+/// Copyright (c) 2025 bulgogi-framework
+/// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <boost/json.hpp>
+
+
+namespace bulgogi {
+
+    /// Content-Type of the Prometheus text exposition format.
+    inline constexpr std::string_view PROMETHEUS_MIME = "text/plain; version=0.0.4; charset=utf-8";
+
+    /// Append the `# HELP` / `# TYPE` lines of one metric family.
+    inline void prometheus_family(std::string &out, const std::string_view name, const std::string_view type,
+                                  const std::string_view help) {
+        out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+        out.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+    }
+
+    /**
+     * @brief Append one sample line, `name{labels} value`.
+     * @param labels Rendered label pairs without braces, e.g. `route="api/ping"`; empty for none.
+     *        Values are route paths and status codes, nothing that needs escaping.
+     */
+    template<typename T> requires std::is_arithmetic_v<T>
+    void prometheus_sample(std::string &out, const std::string_view name, const std::string_view labels,
+                           const T value) {
+        out.append(name);
+        if (!labels.empty()) out.append("{").append(labels).append("}");
+        out += ' ';
+        char buf[32];
+        const auto [end, _] = std::to_chars(buf, buf + sizeof(buf), value);
+        out.append(buf, end).append("\n");
+    }
+
+    /// Threads of this process right now, from /proc; nullopt where there is no procfs.
+    [[nodiscard]] inline std::optional<size_t> live_threads() {
+        std::error_code ec;
+        std::filesystem::directory_iterator it("/proc/self/task", ec);
+        if (ec) return std::nullopt;
+        size_t count = 0;
+        for (; it != std::filesystem::directory_iterator(); it.increment(ec)) {
+            if (ec) return std::nullopt;
+            ++count;
+        }
+        return count;
+    }
+
+    /**
+     * @brief Server-wide connection counters, updated by the sessions in main.cpp.
+     *
+     * Relaxed atomics only: the numbers are for dashboards, a snapshot may mix values
+     * from slightly different instants.
+     */
+    class ConnectionMetrics final {
+    public:
+        /// Requests-per-connection histogram buckets: <= 1, 2, 4, ... 128, then everything above.
+        static constexpr size_t BUCKETS = 9;
+
+        void opened() noexcept {
+            connections_total.fetch_add(1, std::memory_order_relaxed);
+            connections_active.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /// @param requests Requests the connection served before it was closed.
+        void closed(const uint64_t requests) noexcept {
+            connections_active.fetch_sub(1, std::memory_order_relaxed);
+            requests_total.fetch_add(requests, std::memory_order_relaxed);
+            if (requests > 1) reused_total.fetch_add(requests - 1, std::memory_order_relaxed);
+
+            const size_t bucket = requests <= 1 ? 0 : std::min<size_t>(std::bit_width(requests - 1), BUCKETS - 1);
+            per_connection[bucket].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void idle_timeout() noexcept {
+            idle_timeouts.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] boost::json::object to_json() const {
+            boost::json::object obj;
+            obj["connections_total"] = connections_total.load(std::memory_order_relaxed);
+            obj["connections_active"] = connections_active.load(std::memory_order_relaxed);
+            obj["requests_total"] = requests_total.load(std::memory_order_relaxed);
+            obj["keep_alive_reuses"] = reused_total.load(std::memory_order_relaxed);
+            obj["idle_timeouts"] = idle_timeouts.load(std::memory_order_relaxed);
+
+            boost::json::array histogram;
+            for (size_t b = 0; b < BUCKETS; ++b) {
+                boost::json::object bucket;
+                if (b + 1 < BUCKETS) bucket["le"] = uint64_t{1} << b;
+                else bucket["le"] = "+Inf";
+                bucket["connections"] = per_connection[b].load(std::memory_order_relaxed);
+                histogram.emplace_back(bucket);
+            }
+            obj["requests_per_connection"] = histogram;
+            return obj;
+        }
+
+        void write_prometheus(std::string &out) const {
+            prometheus_family(out, "bulgogi_sessions_in_flight", "gauge", "Open client connections.");
+            prometheus_sample(out, "bulgogi_sessions_in_flight", "", connections_active.load(std::memory_order_relaxed));
+            prometheus_family(out, "bulgogi_connections_total", "counter", "Connections accepted.");
+            prometheus_sample(out, "bulgogi_connections_total", "", connections_total.load(std::memory_order_relaxed));
+            prometheus_family(out, "bulgogi_keep_alive_reuses_total", "counter",
+                              "Requests served after the first on their connection, closed connections only.");
+            prometheus_sample(out, "bulgogi_keep_alive_reuses_total", "", reused_total.load(std::memory_order_relaxed));
+            prometheus_family(out, "bulgogi_idle_timeouts_total", "counter", "Keep-alive connections closed idle.");
+            prometheus_sample(out, "bulgogi_idle_timeouts_total", "", idle_timeouts.load(std::memory_order_relaxed));
+        }
+
+    private:
+        std::atomic<uint64_t> connections_total{0};
+        std::atomic<int64_t> connections_active{0};
+        std::atomic<uint64_t> requests_total{0}; /// of closed connections
+        std::atomic<uint64_t> reused_total{0};   /// requests after the first on their connection
+        std::atomic<uint64_t> idle_timeouts{0};
+        std::array<std::atomic<uint64_t>, BUCKETS> per_connection{};
+    };
+
+    inline ConnectionMetrics &connection_metrics() {
+        static ConnectionMetrics metrics;
+        return metrics;
+    }
+
+    /**
+     * @brief Per-route request counts, status codes and latency histograms.
+     *
+     * Every recording thread (the io threads) owns a shard and is its only writer: a record is a
+     * handful of relaxed load/store pairs on thread-private cache lines, no lock and no locked
+     * instruction. Readers merge all shards; shards outlive their threads, so counts never go back.
+     *
+     * Latency buckets are HDR-style log-linear: below 2^SUB_BITS µs one per microsecond, above that
+     * 2^SUB_BITS per power of two (at most 12.5 % relative error), everything from 2^MAX_EXP µs on
+     * (~2 min) in the last one. Prometheus gets the power-of-two edges, to_json the percentiles.
+     * Buckets include their upper end, as Prometheus' `le` does: v µs is counted in bucket_of(v - 1),
+     * so bucket b holds (bucket_end(b - 1), bucket_end(b)].
+     */
+    class RequestMetrics final {
+    public:
+        static constexpr uint32_t SUB_BITS = 3;
+        static constexpr uint32_t MAX_EXP = 27;
+        static constexpr size_t LATENCY_BUCKETS = size_t{MAX_EXP - SUB_BITS + 1} << SUB_BITS;
+        static constexpr unsigned MIN_STATUS = 100, MAX_STATUS = 599;
+
+        /**
+         * @brief Name the routes; call once, before the first record.
+         * @param routes Route i is recorded as index i (Router::index_of), one more slot takes unmatched paths.
+         */
+        void init(std::vector<std::string> routes) {
+            names = std::move(routes);
+            names.emplace_back("<unmatched>");
+        }
+
+        /// Index of the slot for requests no view serves.
+        [[nodiscard]] size_t unmatched() const noexcept { return names.size() - 1; }
+
+        void record(const size_t route, const unsigned status, const std::chrono::steady_clock::duration elapsed) noexcept {
+            const auto micros = static_cast<uint64_t>(
+                    std::max<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count(), 0));
+            Shard &shard = local_shard();
+            RouteCells &cells = shard.routes[route];
+            cells.by_class[status_class(status)].add(1);
+            cells.latency[bucket_of(micros > 0 ? micros - 1 : 0)].add(1);
+            cells.latency_sum_us.add(micros);
+            if (status >= MIN_STATUS && status <= MAX_STATUS) shard.status[status - MIN_STATUS].add(1);
+        }
+
+        [[nodiscard]] static size_t bucket_of(const uint64_t micros) noexcept {
+            constexpr uint64_t SUB = uint64_t{1} << SUB_BITS;
+            if (micros < SUB) return micros;
+            const auto exp = static_cast<uint32_t>(std::bit_width(micros) - 1);
+            if (exp >= MAX_EXP) return LATENCY_BUCKETS - 1;
+            return size_t{exp - SUB_BITS + 1} << SUB_BITS | (micros >> (exp - SUB_BITS) & (SUB - 1));
+        }
+
+        /// Largest latency in µs counted in @p bucket.
+        [[nodiscard]] static uint64_t bucket_end(const size_t bucket) noexcept {
+            constexpr uint64_t SUB = uint64_t{1} << SUB_BITS;
+            if (bucket < SUB) return bucket + 1;
+            const size_t group = bucket >> SUB_BITS;
+            return (SUB + (bucket & (SUB - 1)) + 1) << (group - 1);
+        }
+
+        /// Routes that served requests, with count, 5xx and latency percentiles in milliseconds.
+        [[nodiscard]] boost::json::object to_json() const {
+            const Merged merged = merge();
+            boost::json::object routes;
+            for (size_t r = 0; r < names.size(); ++r) {
+                const MergedRoute &route = merged.routes[r];
+                const uint64_t count = route.total();
+                if (count == 0) continue;
+
+                boost::json::object item;
+                item["count"] = count;
+                item["server_errors"] = route.by_class[4];
+                item["p50_ms"] = percentile_ms(route, count, 0.50);
+                item["p90_ms"] = percentile_ms(route, count, 0.90);
+                item["p99_ms"] = percentile_ms(route, count, 0.99);
+                routes[names[r]] = item;
+            }
+
+            boost::json::object status;
+            for (unsigned code = MIN_STATUS; code <= MAX_STATUS; ++code) {
+                if (const uint64_t n = merged.status[code - MIN_STATUS]) status[std::to_string(code)] = n;
+            }
+
+            boost::json::object obj;
+            obj["routes"] = routes;
+            obj["status"] = status;
+            return obj;
+        }
+
+        void write_prometheus(std::string &out) const {
+            static constexpr std::string_view CLASSES[] = {"1xx", "2xx", "3xx", "4xx", "5xx"};
+            const Merged merged = merge();
+            std::string labels;
+
+            prometheus_family(out, "bulgogi_requests_total", "counter", "Requests answered, by route and status class.");
+            for (size_t r = 0; r < names.size(); ++r) {
+                for (size_t c = 0; c < std::size(CLASSES); ++c) {
+                    if (const uint64_t n = merged.routes[r].by_class[c]) {
+                        labels.assign("route=\"").append(names[r]).append("\",code=\"").append(CLASSES[c]).append("\"");
+                        prometheus_sample(out, "bulgogi_requests_total", labels, n);
+                    }
+                }
+            }
+
+            prometheus_family(out, "bulgogi_responses_total", "counter", "Responses by status code.");
+            for (unsigned code = MIN_STATUS; code <= MAX_STATUS; ++code) {
+                if (const uint64_t n = merged.status[code - MIN_STATUS]) {
+                    labels.assign("code=\"").append(std::to_string(code)).append("\"");
+                    prometheus_sample(out, "bulgogi_responses_total", labels, n);
+                }
+            }
+
+            // Power-of-two edges from 32 µs to ~67 s; each is the upper end of a bucket, so `le` counts are exact
+            constexpr uint32_t FIRST_EDGE = 5, LAST_EDGE = MAX_EXP - 1;
+            prometheus_family(out, "bulgogi_request_duration_seconds", "histogram",
+                              "Time from a parsed request to its ready response, by route.");
+            for (size_t r = 0; r < names.size(); ++r) {
+                const MergedRoute &route = merged.routes[r];
+                const uint64_t count = route.total();
+                if (count == 0) continue;
+
+                const std::string route_label = "route=\"" + names[r] + "\"";
+                uint64_t cumulative = 0;
+                size_t bucket = 0;
+                for (uint32_t edge = FIRST_EDGE; edge <= LAST_EDGE; ++edge) {
+                    const size_t end = bucket_of(uint64_t{1} << edge);
+                    for (; bucket < end; ++bucket) cumulative += route.latency[bucket];
+
+                    char le[32];
+                    const auto [le_end, _] = std::to_chars(le, le + sizeof(le), static_cast<double>(uint64_t{1} << edge) / 1e6);
+                    labels.assign(route_label).append(",le=\"").append(le, le_end).append("\"");
+                    prometheus_sample(out, "bulgogi_request_duration_seconds_bucket", labels, cumulative);
+                }
+                labels.assign(route_label).append(",le=\"+Inf\"");
+                prometheus_sample(out, "bulgogi_request_duration_seconds_bucket", labels, count);
+                prometheus_sample(out, "bulgogi_request_duration_seconds_sum", route_label,
+                                  static_cast<double>(route.latency_sum_us) / 1e6);
+                prometheus_sample(out, "bulgogi_request_duration_seconds_count", route_label, count);
+            }
+        }
+
+    private:
+        /// Written by one thread only, so an increment needs no read-modify-write instruction.
+        struct Counter {
+            std::atomic<uint64_t> value{0};
+
+            void add(const uint64_t n) noexcept {
+                value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+            }
+
+            [[nodiscard]] uint64_t get() const noexcept { return value.load(std::memory_order_relaxed); }
+        };
+
+        struct RouteCells {
+            std::array<Counter, 5> by_class{};  /// 1xx .. 5xx
+            std::array<Counter, LATENCY_BUCKETS> latency{};
+            Counter latency_sum_us;
+        };
+
+        struct alignas(64) Shard {
+            explicit Shard(const size_t routes) : routes(std::make_unique<RouteCells[]>(routes)) {}
+
+            std::unique_ptr<RouteCells[]> routes;
+            std::array<Counter, MAX_STATUS - MIN_STATUS + 1> status{};
+        };
+
+        struct MergedRoute {
+            std::array<uint64_t, 5> by_class{};
+            std::array<uint64_t, LATENCY_BUCKETS> latency{};
+            uint64_t latency_sum_us = 0;
+
+            [[nodiscard]] uint64_t total() const noexcept {
+                uint64_t sum = 0;
+                for (const uint64_t n: by_class) sum += n;
+                return sum;
+            }
+        };
+
+        struct Merged {
+            std::vector<MergedRoute> routes;
+            std::array<uint64_t, MAX_STATUS - MIN_STATUS + 1> status{};
+        };
+
+        std::vector<std::string> names;
+        mutable std::mutex shards_mut;                /// taken by a thread's first record and by readers
+        std::vector<std::unique_ptr<Shard>> shards;
+
+        static size_t status_class(const unsigned status) noexcept {
+            return status >= 100 && status <= 599 ? status / 100 - 1 : 4; // nonsense codes count as 5xx
+        }
+
+        /// One RequestMetrics per process: the shard pointer is per thread, not per instance.
+        Shard &local_shard() {
+            thread_local Shard *shard = nullptr;
+            if (!shard) [[unlikely]] {
+                std::lock_guard lock(shards_mut);
+                shard = shards.emplace_back(std::make_unique<Shard>(names.size())).get();
+            }
+            return *shard;
+        }
+
+        [[nodiscard]] Merged merge() const {
+            Merged merged;
+            merged.routes.resize(names.size());
+            std::lock_guard lock(shards_mut);
+            for (const auto &shard: shards) {
+                for (size_t r = 0; r < names.size(); ++r) {
+                    const RouteCells &cells = shard->routes[r];
+                    MergedRoute &route = merged.routes[r];
+                    for (size_t c = 0; c < route.by_class.size(); ++c) route.by_class[c] += cells.by_class[c].get();
+                    for (size_t b = 0; b < LATENCY_BUCKETS; ++b) route.latency[b] += cells.latency[b].get();
+                    route.latency_sum_us += cells.latency_sum_us.get();
+                }
+                for (size_t s = 0; s < merged.status.size(); ++s) merged.status[s] += shard->status[s].get();
+            }
+            return merged;
+        }
+
+        /// Upper edge of the bucket holding the @p q quantile, in milliseconds. Class counts and buckets
+        /// are read at slightly different instants, so the walk falls back to the last bucket.
+        static double percentile_ms(const MergedRoute &route, const uint64_t count, const double q) {
+            const auto rank = static_cast<uint64_t>(q * static_cast<double>(count - 1)) + 1;
+            uint64_t seen = 0;
+            for (size_t b = 0; b < LATENCY_BUCKETS; ++b) {
+                seen += route.latency[b];
+                if (seen >= rank) return static_cast<double>(bucket_end(b)) / 1e3;
+            }
+            return static_cast<double>(bucket_end(LATENCY_BUCKETS - 1)) / 1e3;
+        }
+    };
+
+    inline RequestMetrics &request_metrics() {
+        static RequestMetrics metrics;
+        return metrics;
+    }
+
+}
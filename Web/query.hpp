@@ -0,0 +1,206 @@
+/// Copyright (c) 2025 bulgogi-framework
+/// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <boost/beast/http.hpp>
+
+
+namespace bulgogi {
+
+    /// Why a typed query parameter could not be read.
+    enum class QueryError : uint8_t {
+        none,
+        missing,       /// key not in the query string
+        malformed,     /// not a value of the requested type
+        out_of_range   /// a number too large for the requested type
+    };
+
+    [[nodiscard]] inline std::string_view to_string(const QueryError error) noexcept {
+        switch (error) {
+            case QueryError::none:
+                return "none";
+            case QueryError::missing:
+                return "missing";
+            case QueryError::malformed:
+                return "malformed";
+            case QueryError::out_of_range:
+                return "out of range";
+        }
+        return "unknown";
+    }
+
+    /// A parameter read by Query::get: the value, or why there is none.
+    template<typename T>
+    struct QueryValue {
+        T value{};
+        QueryError error = QueryError::missing;
+
+        explicit operator bool() const noexcept { return error == QueryError::none; }
+
+        const T &operator*() const noexcept { return value; }
+
+        [[nodiscard]] bool missing() const noexcept { return error == QueryError::missing; }
+
+        /// @p fallback unless the value was read; check error first where malformed input must be a 400.
+        [[nodiscard]] T value_or(T fallback) const { return error == QueryError::none ? value : fallback; }
+    };
+
+    /**
+     * @brief The query string of one request, split once into a flat array of string_view pairs.
+     *
+     * Views into the request target, no copies: the request must outlive the Query. Keys and values
+     * are percent-decoded (and '+' read as space) only if they contain an escape; values lazily, on
+     * their first read. Numbers go through std::from_chars and report a QueryError instead of throwing.
+     * The first occurrence of a repeated key wins; parameters past MAX_PARAMS are ignored.
+     *
+     * @code
+     * const bulgogi::Query query(req);
+     * const auto id = query.get<uint32_t>("id");
+     * if (!id) { set_json(res, {{"error", "Missing user ID"}}, 400); return; }
+     * load(*id);
+     * @endcode
+     */
+    class Query final {
+    public:
+        static constexpr size_t MAX_PARAMS = 16;
+
+        explicit Query(std::string_view target) {
+            const size_t q = target.find('?');
+            if (q == std::string_view::npos) return;
+            std::string_view rest = target.substr(q + 1);
+            rest = rest.substr(0, rest.find('#'));
+
+            while (!rest.empty() && count < MAX_PARAMS) {
+                const size_t amp = rest.find('&');
+                const std::string_view pair = rest.substr(0, amp);
+                rest.remove_prefix(amp == std::string_view::npos ? rest.size() : amp + 1);
+                if (pair.empty()) continue;
+
+                const size_t eq = pair.find('=');
+                Param &param = params[count++];
+                param.key = pair.substr(0, eq);
+                param.value = eq == std::string_view::npos ? std::string_view{} : pair.substr(eq + 1);
+                if (needs_decoding(param.key)) {
+                    param.key_decoded = decode(param.key);
+                    param.key = param.key_decoded;
+                }
+                param.value_encoded = needs_decoding(param.value);
+            }
+        }
+
+        explicit Query(const boost::beast::http::request<boost::beast::http::string_body> &req)
+                : Query(std::string_view(req.target().data(), req.target().size())) {}
+
+        // Decoded keys point into the params themselves
+        Query(const Query &) = delete;
+
+        Query &operator=(const Query &) = delete;
+
+        [[nodiscard]] bool contains(const std::string_view key) const noexcept { return find(key) != nullptr; }
+
+        /// Decoded value of @p key as text, nullopt if absent; valid as long as the Query.
+        [[nodiscard]] std::optional<std::string_view> text(const std::string_view key) const {
+            const Param *param = find(key);
+            if (!param) return std::nullopt;
+            if (param->value_encoded) {
+                param->value_decoded = decode(param->value);
+                param->value = param->value_decoded;
+                param->value_encoded = false;
+            }
+            return param->value;
+        }
+
+        /**
+         * @brief @p key as @p T: an integer or floating-point type, bool (true/false/1/0),
+         *        std::string_view or std::string.
+         */
+        template<typename T>
+        [[nodiscard]] QueryValue<T> get(const std::string_view key) const {
+            QueryValue<T> out{};
+            const auto raw = text(key);
+            if (!raw) return out;
+
+            if constexpr (std::is_same_v<T, std::string_view>) {
+                out.value = *raw;
+                out.error = QueryError::none;
+            } else if constexpr (std::is_same_v<T, std::string>) {
+                out.value = std::string(*raw);
+                out.error = QueryError::none;
+            } else if constexpr (std::is_same_v<T, bool>) {
+                if (*raw == "true" || *raw == "1") out.value = true;
+                else if (*raw == "false" || *raw == "0") out.value = false;
+                else {
+                    out.error = QueryError::malformed;
+                    return out;
+                }
+                out.error = QueryError::none;
+            } else {
+                static_assert(std::is_arithmetic_v<T>, "Query::get<T>: unsupported type");
+                const char *first = raw->data();
+                const char *last = first + raw->size();
+                const auto [end, ec] = std::from_chars(first, last, out.value);
+                if (ec == std::errc::result_out_of_range) out.error = QueryError::out_of_range;
+                else if (ec != std::errc{} || end != last || first == last) out.error = QueryError::malformed;
+                else out.error = QueryError::none;
+            }
+            return out;
+        }
+
+    private:
+        struct Param {
+            std::string_view key;
+            mutable std::string_view value;
+            std::string key_decoded;
+            mutable std::string value_decoded;
+            mutable bool value_encoded = false;
+        };
+
+        std::array<Param, MAX_PARAMS> params{};
+        size_t count = 0;
+
+        [[nodiscard]] const Param *find(const std::string_view key) const noexcept {
+            for (size_t i = 0; i < count; ++i) {
+                if (params[i].key == key) return &params[i];
+            }
+            return nullptr;
+        }
+
+        static bool needs_decoding(const std::string_view s) noexcept {
+            return s.find_first_of("%+") != std::string_view::npos;
+        }
+
+        /// Percent-decoding; a '%' not followed by two hex digits is kept as is.
+        static std::string decode(const std::string_view s) {
+            const auto hex = [](const char c) -> int {
+                if (c >= '0' && c <= '9') return c - '0';
+                if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+                if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+                return -1;
+            };
+
+            std::string out;
+            out.reserve(s.size());
+            for (size_t i = 0; i < s.size(); ++i) {
+                if (s[i] == '+') {
+                    out += ' ';
+                } else if (s[i] == '%' && i + 2 < s.size() && hex(s[i + 1]) >= 0 && hex(s[i + 2]) >= 0) {
+                    out += static_cast<char>(hex(s[i + 1]) << 4 | hex(s[i + 2]));
+                    i += 2;
+                } else {
+                    out += s[i];
+                }
+            }
+            return out;
+        }
+    };
+
+}
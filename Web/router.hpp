@@ -0,0 +1,105 @@
+/// Copyright (c) 2025 bulgogi-framework
+/// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "views.hpp"
+
+
+namespace bulgogi {
+
+    /**
+     * @brief Routes of views::function_map and views::async_function_map, frozen into a perfect hash.
+     *
+     * Built once at startup: a seed is searched so that every path lands in its own slot, so a lookup
+     * is one hash of the string_view, one slot and one string compare, without allocating. The table
+     * never changes afterwards and is read by every io and handler thread without locking.
+     */
+    class Router final {
+    public:
+        struct Route {
+            std::string path;                          /// without the leading '/'
+            views::HandlerFunc sync = nullptr;
+            views::AsyncHandlerFunc async = nullptr;   /// a coroutine view wins over a sync one
+        };
+
+        Router(const std::unordered_map<std::string, views::HandlerFunc> &sync,
+               const std::unordered_map<std::string, views::AsyncHandlerFunc> &async) {
+            for (const auto &[path, func]: async) entries.push_back({path, nullptr, func});
+            for (const auto &[path, func]: sync) {
+                if (!async.contains(path)) entries.push_back({path, func, nullptr});
+            }
+            freeze();
+        }
+
+        /// Path of a request target: query and leading '/' stripped, "/api/x?id=1" -> "api/x".
+        static std::string_view route_of(std::string_view target) noexcept {
+            target = target.substr(0, target.find('?'));
+            if (!target.empty() && target.front() == '/') target.remove_prefix(1);
+            return target;
+        }
+
+        /// @param target Request target or route path, see route_of. @return nullptr if no view serves it.
+        [[nodiscard]] const Route *find(std::string_view target) const noexcept {
+            const std::string_view path = route_of(target);
+            const uint32_t slot = slots[hash(path, seed) & mask];
+            if (slot == 0) return nullptr;
+            const Route &route = entries[slot - 1];
+            return route.path == path ? &route : nullptr;
+        }
+
+        [[nodiscard]] const std::vector<Route> &routes() const noexcept { return entries; }
+
+        /// Position of @p route in routes(), a dense id for per-route tables.
+        [[nodiscard]] size_t index_of(const Route &route) const noexcept {
+            return static_cast<size_t>(&route - entries.data());
+        }
+
+    private:
+        std::vector<Route> entries;
+        std::vector<uint32_t> slots;  /// index into entries + 1, 0 = empty
+        uint64_t seed = 0;
+        uint64_t mask = 0;
+
+        /// FNV-1a, offset basis mixed with the seed.
+        static uint64_t hash(const std::string_view key, const uint64_t seed) noexcept {
+            uint64_t h = 0xcbf29ce484222325ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+            for (const char c: key) {
+                h ^= static_cast<unsigned char>(c);
+                h *= 0x100000001b3ULL;
+            }
+            return h ^ (h >> 29);
+        }
+
+        void freeze() {
+            // Load factor <= 1/2, a collision-free seed turns up within a few tries
+            for (size_t size = std::bit_ceil(std::max<size_t>(entries.size() * 2, 2)); size <= (1u << 20); size *= 2) {
+                for (uint64_t candidate = 0; candidate < 4096; ++candidate) {
+                    if (try_place(size, candidate)) return;
+                }
+            }
+            throw std::runtime_error("Router: no perfect hash for the registered routes");
+        }
+
+        bool try_place(const size_t size, const uint64_t candidate) {
+            slots.assign(size, 0);
+            for (size_t i = 0; i < entries.size(); ++i) {
+                uint32_t &slot = slots[hash(entries[i].path, candidate) & (size - 1)];
+                if (slot != 0) return false;
+                slot = static_cast<uint32_t>(i + 1);
+            }
+            seed = candidate;
+            mask = size - 1;
+            return true;
+        }
+    };
+
+}
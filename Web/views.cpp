@@ -1,14 +1,25 @@
 #include "views.hpp"
 #include "bulgogi.hpp"
+#include "metrics.hpp"
+#include "admission.hpp"
+#include "async.hpp"
 #include "../Application/UserModelHandler.hpp"
 #include "../Application/FabricInfoHandler.hpp"
 #include "../Application/Business.hpp"
+#include "../Application/IngestQueue.hpp"
+#include "../Application/FofCursor.hpp"
+#include "../Application/PaginationStore.hpp"
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
 #include <boost/json.hpp>
+#include <charconv>
 #include <iostream>
 #include <random>
 #include <mysql/mysql.h>
 #include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
 
 namespace json = boost::json;
 using bulgogi::Request; /// @brief HTTP request
@@ -16,18 +27,191 @@ using bulgogi::Response; /// @brief HTTP response
 using bulgogi::check_method; /// @brief Check HTTP method
 using bulgogi::set_json; /// @brief Set JSON response
 
-std::mt19937 &global_rng() {
-    static std::mt19937 rng([] {
+fabric::rng_engine &global_rng() {
+    static std::mutex root_mutex;
+    static fabric::rng_engine root([] {
         std::random_device rd;
-        return std::mt19937(rd() ^ static_cast<unsigned>(time(nullptr)));
+        return (static_cast<uint64_t>(rd()) << 32 | rd()) ^ static_cast<uint64_t>(time(nullptr));
     }());
+
+    // Every thread takes the current root stream, the root then moves 2^192 draws ahead
+    thread_local fabric::rng_engine rng = [] {
+        std::lock_guard lock(root_mutex);
+        fabric::rng_engine stream = root;
+        root.long_jump();
+        return stream;
+    }();
     return rng;
 }
 
+/// @brief Read the optional query parameter @p key into @p out, which keeps its value when the key is absent.
+/// A value that does not parse as T sets a 400, false means early return.
+template<typename T>
+static bool read_param(const bulgogi::Query &query, const std::string_view key, T &out, bulgogi::Response &res) {
+    const auto param = query.get<T>(key);
+    if (param.missing()) return true;
+    if (!param) {
+        set_json(res, {{"error",  "Invalid query parameter"},
+                       {"param",  key},
+                       {"reason", bulgogi::to_string(param.error)}}, 400);
+        return false;
+    }
+    out = *param;
+    return true;
+}
+
+/// @brief read_param for a parameter the view cannot do without, @p missing_error is its 400 message.
+template<typename T>
+static bool require_param(const bulgogi::Query &query, const std::string_view key, T &out, bulgogi::Response &res,
+                          const char *missing_error) {
+    if (!query.contains(key)) {
+        set_json(res, {{"error", missing_error}}, 400);
+        return false;
+    }
+    return read_param(query, key, out, res);
+}
+
+/// @brief Read `seed` from the query string, or draw a fresh one so the run can be replayed later.
+/// Fresh seeds keep to 53 bits so they survive a round-trip through JavaScript numbers.
+static bool resolve_seed(const bulgogi::Query &query, bulgogi::Response &res, uint64_t &seed) {
+    seed = global_rng()() >> 11;
+    return read_param(query, "seed", seed, res);
+}
+
 
 static MYSQL *g_mysql_conn = nullptr;
 static std::unique_ptr<social::UserModelHandler> g_user_handler{};
 static std::unique_ptr<fabric::FabricInfoHandler> g_fabric_handler{};
+/// Whether both handlers are set, for io-thread readers, which must not touch the unique_ptrs themselves.
+static std::atomic<bool> g_handlers_published{false};
+/// Held shared by offloaded work of async views while it uses the handlers, exclusively while they are replaced.
+static std::shared_mutex g_handlers_mutex;
+
+/// @brief Serializes everything that rewrites the population: simulate_day, refresh_db and the ingest drain.
+static std::mutex g_simulation_mutex;
+/// @brief Interactions posted to api/ingest_interactions, waiting for _batch_update_interactions.
+static social::IngestQueue g_ingest;
+
+/// @brief Paused recommend_fof searches and recommend_strangers rankings, continued by `cursor`.
+/// Bounded by count and by bytes: one deep search over a large population can hold tens of MiB.
+static social::PaginationStore<social::FofCursor> g_fof_cursors{256, size_t{64} << 20, std::chrono::minutes(5)};
+static social::PaginationStore<social::RankedPool> g_stranger_pools{1024, size_t{16} << 20, std::chrono::minutes(5)};
+
+/// @brief Drop every paused page after a bulk rewrite of the population, so no page mixes two graphs.
+/// Ingested interactions and single-user writes leave them alone, like any other cached read.
+static void forget_paused_pages() {
+    g_fof_cursors.clear();
+    g_stranger_pools.clear();
+}
+
+/// @brief Candidates ranked up front for a paginated recommend_strangers.
+constexpr size_t STRANGER_POOL = 200;
+
+/// @brief `page_size` from the query string (@p fallback if absent), clamped to [1, max].
+static bool resolve_page_size(const bulgogi::Query &query, bulgogi::Response &res, const size_t fallback,
+                              const size_t max, size_t &page_size) {
+    page_size = fallback;
+    if (!read_param(query, "page_size", page_size, res)) return false;
+    page_size = std::clamp<size_t>(page_size, 1, max);
+    return true;
+}
+
+/// @brief Strong ETag of what the get_user_* views answer for @p id: generation and change counter of the user,
+/// then @p variant when a view has several representations. Taken before the view reads, see social::UserVersions.
+static std::string user_etag(const uint32_t id, const std::string_view variant = {}) {
+    const auto [generation, counter] = social::user_versions().get(id);
+    char buf[64];
+    char *end = buf;
+    *end++ = '"';
+    end = std::to_chars(end, buf + sizeof(buf), generation, 16).ptr;
+    *end++ = '-';
+    end = std::to_chars(end, buf + sizeof(buf), counter).ptr;
+
+    std::string etag(buf, end);
+    if (!variant.empty()) {
+        etag += '-';
+        etag += variant;
+    }
+    etag += '"';
+    return etag;
+}
+
+/// @brief Bytes one id takes in a JSON array at most: 10 digits and a comma.
+constexpr size_t ID_JSON_BYTES = 11;
+
+/// @brief Write the ids of a fixed-size result as a JSON array, INVALID_FRIEND_ID marks empty slots.
+template<typename Ids>
+static void write_ids(bulgogi::JsonWriter &json, const Ids &ids) {
+    json.begin_array();
+    for (const uint32_t id: ids) {
+        if (id != INVALID_FRIEND_ID) json.value(id);
+    }
+    json.end_array();
+}
+
+/// @brief The filled part of a fixed-size result: results are packed to the front, INVALID_FRIEND_ID pads the rest.
+template<typename Ids>
+static std::span<const uint32_t> filled_ids(const Ids &ids) {
+    const auto first = std::begin(ids);
+    const auto end = std::find(first, std::end(ids), INVALID_FRIEND_ID);
+    return {std::to_address(first), static_cast<size_t>(end - first)};
+}
+
+/// @brief Token of the page after this one, nullopt when the state has nothing left or outgrew @p store;
+/// the latter marks @p stats partial, the rest of that search is dropped.
+template<typename State>
+static std::optional<std::string> next_cursor(State &&state, social::PaginationStore<std::decay_t<State>> &store,
+                                              social::SearchStats *stats = nullptr) {
+    if (state.exhausted()) return std::nullopt;
+    auto token = store.put(std::forward<State>(state));
+    if (!token && stats) stats->partial = true;
+    return token;
+}
+
+/// @brief What an id list response carries besides the ids.
+struct IdListMeta {
+    bool paginated = false;
+    std::optional<std::string> cursor;          /// of the next page, paginated only
+    const social::SearchStats *stats = nullptr; /// searches only
+};
+
+/**
+ * @brief Answer with an id list in the format the client negotiated.
+ *
+ * JSON by default: `{"<field>": [...], "cursor": ..., "partial": ..., "expansions": ..., "db_calls": ...}`.
+ * With `Accept: application/octet-stream` the ids are the binary body of bulgogi::set_id_list and the
+ * other fields travel as X-Cursor, X-Partial, X-Expansions and X-Db-Calls headers.
+ */
+static void send_ids(const bulgogi::Request &req, bulgogi::Response &res, const std::string_view field,
+                     const std::span<const uint32_t> ids, const IdListMeta &meta = {}) {
+    if (bulgogi::accepts_id_list(req)) {
+        bulgogi::set_id_list(res, ids);
+        if (meta.cursor) res.set("X-Cursor", *meta.cursor);
+        if (meta.stats) {
+            res.set("X-Partial", meta.stats->partial ? "true" : "false");
+            res.set("X-Expansions", std::to_string(meta.stats->expansions));
+            res.set("X-Db-Calls", std::to_string(meta.stats->db_calls));
+        }
+    } else {
+        bulgogi::write_json(res, [&](bulgogi::JsonWriter &json) {
+            json.begin_object().key(field).begin_array();
+            for (const uint32_t id: ids) json.value(id);
+            json.end_array();
+            if (meta.paginated) {
+                json.key("cursor");
+                if (meta.cursor) json.value(*meta.cursor);
+                else json.value(nullptr);
+            }
+            if (meta.stats) {
+                json.key("partial").value(meta.stats->partial)
+                        .key("expansions").value(meta.stats->expansions)
+                        .key("db_calls").value(meta.stats->db_calls);
+            }
+            json.end_object();
+        }, 200, ids.size() * ID_JSON_BYTES + 160);
+    }
+    res.set(bulgogi::http::field::vary, "Accept");
+}
 
 inline bool ensure_mysql_ready(bulgogi::Response &res, MYSQL *conn) {
     if (!conn || !g_user_handler || !g_fabric_handler) {
@@ -45,9 +229,20 @@ inline bool ensure_mysql_ready(bulgogi::Response &res, MYSQL *conn) {
     return true;
 }
 
+/// @brief ensure_mysql_ready for async views, from the io thread: reads the published flag only.
+static bool ensure_handlers_published(bulgogi::Response &res) {
+    if (g_handlers_published) return true;
+    set_json(res, {{"error", "MySQL not connected or handlers uninitialized"},
+                   {"hint",  "POST /api/set_db_connection to reinitialize"}}, 500);
+    return false;
+}
+
 /// @brief Global function map for registered urls
 std::unordered_map<std::string, views::HandlerFunc> views::function_map;
 
+/// @brief Global function map for registered coroutine views
+std::unordered_map<std::string, views::AsyncHandlerFunc> views::async_function_map;
+
 /// @brief Atomic boolean to signal server shutdown
 extern std::atomic<bool> g_should_exit;
 
@@ -63,8 +258,14 @@ void views::init() {
 
 
 void views::atexit() {
-    g_user_handler.reset();
-    g_fabric_handler.reset();
+    g_ingest.stop(); // applies what is queued while the handlers still exist
+    forget_paused_pages();
+    {
+        std::unique_lock lock(g_handlers_mutex);
+        g_handlers_published = false;
+        g_user_handler.reset();
+        g_fabric_handler.reset();
+    }
 
     if (g_mysql_conn) {
         mysql_close(g_mysql_conn);
@@ -95,20 +296,64 @@ void views::check_head([[maybe_unused]] const bulgogi::Request &req) {
 }
 
 
-REGISTER_VIEW(ping) {
-    if (!check_method(req, bulgogi::http::verb::get, res)) return;
+// Never block: answered on the io thread, a busy handler pool cannot delay them
+REGISTER_ASYNC_VIEW(ping) {
+    if (!check_method(req, bulgogi::http::verb::get, res)) co_return;
     set_json(res, {{"status", "alive"}});
 }
 
+REGISTER_ASYNC_VIEW(api, server_metrics) {
+    if (!check_method(req, bulgogi::http::verb::get, res)) co_return;
+    set_json(res, {{"connections", bulgogi::connection_metrics().to_json()},
+                   {"admission",   bulgogi::admission().to_json()},
+                   {"requests",    bulgogi::request_metrics().to_json()},
+                   {"ingest",      {{"queue_depth", g_ingest.depth()}, {"dropped", g_ingest.dropped()}}}});
+}
+
+REGISTER_ASYNC_VIEW(metrics) {
+    if (!check_method(req, bulgogi::http::verb::get, res)) co_return;
+
+    std::string &out = res.body();
+    out.reserve(16 * 1024);
+    bulgogi::request_metrics().write_prometheus(out);
+    bulgogi::connection_metrics().write_prometheus(out);
+    bulgogi::admission().write_prometheus(out);
+
+    if (const auto threads = bulgogi::live_threads()) {
+        bulgogi::prometheus_family(out, "bulgogi_threads", "gauge", "Threads of the server process.");
+        bulgogi::prometheus_sample(out, "bulgogi_threads", "", *threads);
+    }
+    bulgogi::prometheus_family(out, "bulgogi_ingest_queue_depth", "gauge", "Ingested interactions waiting for the updater.");
+    bulgogi::prometheus_sample(out, "bulgogi_ingest_queue_depth", "", g_ingest.depth());
+    bulgogi::prometheus_family(out, "bulgogi_ingest_dropped_total", "counter",
+                               "Accepted interactions lost because applying their batch failed.");
+    bulgogi::prometheus_sample(out, "bulgogi_ingest_dropped_total", "", g_ingest.dropped());
+
+    // The handler belongs to the handler threads and may be replaced meanwhile, read the published copy
+    if (g_handlers_published) {
+        bulgogi::prometheus_family(out, "bulgogi_fabric_users", "gauge", "Users in UsersFabric.");
+        bulgogi::prometheus_sample(out, "bulgogi_fabric_users", "", fabric::published_fabric_count().load());
+    }
+
+    res.result(bulgogi::http::status::ok);
+    res.set(bulgogi::http::field::content_type, bulgogi::PROMETHEUS_MIME);
+    res.prepare_payload();
+}
+
 REGISTER_VIEW(shutdown_server) {
     if (!check_method(req, bulgogi::http::verb::post, res)) return;
 
     if (!g_should_exit.exchange(true)) {
         std::cout << "Called Exit\n";
 
-        if (global_acceptor && global_acceptor->is_open()) {
-            boost::system::error_code ec;
-            global_acceptor->cancel(ec); // NOLINT
+        if (global_acceptor) {
+            // Only the acceptor's strand may touch it, the listener is suspended there
+            boost::asio::post(global_acceptor->get_executor(), [] {
+                if (global_acceptor && global_acceptor->is_open()) {
+                    boost::system::error_code ec;
+                    global_acceptor->cancel(ec); // NOLINT
+                }
+            });
         }
 
         try {
@@ -130,28 +375,137 @@ REGISTER_VIEW(api, simulate_day) {
         return;
     }
 
-    auto result = fabric::api::next_day(*g_user_handler, *g_fabric_handler);
+    const bulgogi::Query query(req);
+    uint64_t seed = 0;
+    if (!resolve_seed(query, res, seed)) return;
+    fabric::rng_engine rng(seed);
+
+    std::lock_guard lock(g_simulation_mutex);
+    auto result = fabric::api::next_day(*g_user_handler, *g_fabric_handler, rng);
+    forget_paused_pages(); // every friend list may have moved
     set_json(res, {
             {"new_users",          result.new_users},
             {"new_friendships",    result.new_friendships},
-            {"total_interactions", result.total_interactions}
+            {"total_interactions", result.total_interactions},
+            {"rows_loaded",        result.persistence.rows_loaded},
+            {"rows_written",       result.persistence.rows_written},
+            {"bytes_sent",         result.persistence.bytes_sent},
+            {"seed",               seed}
     });
 }
 
-REGISTER_VIEW(api, get_user_profile) {
-    if (!check_method(req, bulgogi::http::verb::get, res)) return;
+REGISTER_VIEW(api, simulate_days) {
+    // n days of simulate_day in one call, pipelined
+    if (!check_method(req, bulgogi::http::verb::post, res)) return;
     if (!ensure_mysql_ready(res, g_mysql_conn)) return;
 
-    auto params = bulgogi::get_query_param(req, "id");
-    if (!params) {
-        set_json(res, {{"error", "Missing user ID"}}, 400);
+    const bulgogi::Query query(req);
+    uint32_t days = 0;
+    if (!require_param(query, "n", days, res, "Missing day count")) return;
+    if (days == 0 || days > fabric::api::SIMULATE_DAYS_MAX) {
+        set_json(res, {{"error", "Day count out of range"}, {"max", fabric::api::SIMULATE_DAYS_MAX}}, 400);
+        return;
+    }
+
+    uint64_t seed = 0;
+    if (!resolve_seed(query, res, seed)) return;
+    fabric::rng_engine rng(seed);
+
+    try {
+        std::lock_guard lock(g_simulation_mutex);
+        const auto start = std::chrono::steady_clock::now();
+        const auto results = fabric::api::simulate_days(days,
+                                                        *g_user_handler, *g_fabric_handler, rng);
+        forget_paused_pages();
+        const auto wall = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+
+        boost::json::array days_json;
+        for (const auto &result: results) {
+            boost::json::object day;
+            day["new_users"] = result.new_users;
+            day["new_friendships"] = result.new_friendships;
+            day["total_interactions"] = result.total_interactions;
+            day["rows_loaded"] = result.persistence.rows_loaded;
+            day["rows_written"] = result.persistence.rows_written;
+            day["bytes_sent"] = result.persistence.bytes_sent;
+            days_json.emplace_back(day);
+        }
+        set_json(res, {{"days",    days_json},
+                       {"wall_ms", wall.count()},
+                       {"seed",    seed}});
+    } catch (const std::exception &e) {
+        set_json(res, {{"error", e.what()}}, 500);
+    }
+}
+
+REGISTER_VIEW(api, ingest_interactions) {
+    // NDJSON (default) or packed InteractionEntry records (application/octet-stream)
+    if (!check_method(req, bulgogi::http::verb::post, res)) return;
+    if (!ensure_mysql_ready(res, g_mysql_conn)) return;
+
+    const bool packed = req[bulgogi::http::field::content_type].starts_with("application/octet-stream");
+
+    social::interaction_input batch;
+    const auto [accepted, skipped, error_line, bad_score] = packed
+                                                            ? social::parse_interactions_packed(req.body(), batch)
+                                                            : social::parse_interactions_ndjson(req.body(), batch);
+    if (bad_score) {
+        set_json(res, {{"error",     "Score out of range"},
+                       {packed ? "record" : "line", error_line},
+                       {"min_score", 1},
+                       {"max_score", social::INGEST_SCORE_MAX}}, 400);
+        return;
+    }
+    if (error_line != 0) {
+        if (packed) {
+            set_json(res, {{"error", "Body size is not a multiple of 12 bytes"}}, 400);
+        } else {
+            set_json(res, {{"error", "Malformed NDJSON"}, {"line", error_line}}, 400);
+        }
+        return;
+    }
+    if (batch.size() > social::IngestQueue::CAPACITY) {
+        set_json(res, {{"error", "Batch larger than the ingest queue"},
+                       {"capacity", social::IngestQueue::CAPACITY}}, 413);
+        return;
+    }
+
+    if (!batch.empty() && !g_ingest.try_push(std::move(batch))) {
+        set_json(res, {{"error",       "Ingest queue full"},
+                       {"queue_depth", g_ingest.depth()},
+                       {"capacity",    social::IngestQueue::CAPACITY}}, 429);
+        res.set(bulgogi::http::field::retry_after, "1");
         return;
     }
 
-    uint32_t user_id = std::stoul(*params);
+    set_json(res, {{"accepted",    accepted},
+                   {"skipped",     skipped},
+                   {"queue_depth", g_ingest.depth()},
+                   {"capacity",    social::IngestQueue::CAPACITY},
+                   {"dropped",     g_ingest.dropped()}}, 202);
+}
+
+REGISTER_ASYNC_VIEW(api, get_user_profile) {
+    if (!check_method(req, bulgogi::http::verb::get, res)) co_return;
+    if (!ensure_handlers_published(res)) co_return;
+
+    const bulgogi::Query query(req);
+    uint32_t user_id = 0;
+    if (!require_param(query, "id", user_id, res, "Missing user ID")) co_return;
+
+    const std::string etag = user_etag(user_id);
+    if (bulgogi::set_not_modified(req, res, etag)) co_return;
+
     try {
-        auto profile = fabric::api::get_user_profile(user_id, *g_user_handler, *g_fabric_handler);
+        // Only the database part takes a handler thread, and an admission slot
+        auto profile = co_await bulgogi::admitted_offload(req, [user_id] {
+            // Checked again under the lock: set_db_connection may have replaced the handlers since
+            std::shared_lock lock(g_handlers_mutex);
+            if (!g_handlers_published) throw std::runtime_error("MySQL not connected or handlers uninitialized");
+            return fabric::api::get_user_profile(user_id, *g_user_handler, *g_fabric_handler);
+        });
         set_json(res, fabric::api::to_json(profile, user_id));
+        bulgogi::set_etag(res, etag);
     } catch (const std::exception &e) {
         set_json(res, {{"error", e.what()}}, 500);
     }
@@ -161,16 +515,17 @@ REGISTER_VIEW(api, get_user_profile_simple) {
     if (!check_method(req, bulgogi::http::verb::get, res)) return;
     if (!ensure_mysql_ready(res, g_mysql_conn)) return;
 
-    auto params = bulgogi::get_query_param(req, "id");
-    if (!params) {
-        set_json(res, {{"error", "Missing user ID"}}, 400);
-        return;
-    }
+    const bulgogi::Query query(req);
+    uint32_t user_id = 0;
+    if (!require_param(query, "id", user_id, res, "Missing user ID")) return;
+
+    const std::string etag = user_etag(user_id);
+    if (bulgogi::set_not_modified(req, res, etag)) return;
 
-    uint32_t user_id = std::stoul(*params);
     try {
         auto simple_profile = fabric::api::get_user_simple_profile(user_id, *g_fabric_handler);
         set_json(res, fabric::api::simple_json(simple_profile, user_id));
+        bulgogi::set_etag(res, etag);
     } catch (const std::exception &e) {
         set_json(res, {{"error", e.what()}}, 500);
     }
@@ -185,11 +540,20 @@ REGISTER_VIEW(api, refresh_db) {
         return;
     }
 
+    const bulgogi::Query query(req);
+    uint64_t seed = 0;
+    if (!resolve_seed(query, res, seed)) return;
+
     try {
+        fabric::rng_engine rng(seed);
+
+        std::lock_guard lock(g_simulation_mutex);
+        forget_paused_pages(); // their users are about to disappear
         fabric::api::clear_all(*g_user_handler, *g_fabric_handler);
-        uint32_t new_user_count = fabric::api::initialize_population(*g_user_handler, *g_fabric_handler);
+        uint32_t new_user_count = fabric::api::initialize_population(*g_user_handler, *g_fabric_handler, rng);
         set_json(res, {{"status",    "database_refreshed"},
-                       {"new_users", new_user_count}});
+                       {"new_users", new_user_count},
+                       {"seed",      seed}});
     } catch (const std::exception &e) {
         set_json(res, {{"error", e.what()}}, 500);
     }
@@ -260,48 +624,209 @@ REGISTER_VIEW(api, recommend_fof) {
     if (!check_method(req, bulgogi::http::verb::get, res)) return;
     if (!ensure_mysql_ready(res, g_mysql_conn)) return;
 
-    auto params = bulgogi::get_query_param(req, "id");
-    if (!params) {
-        set_json(res, {{"error", "Missing user ID"}}, 400);
+    const bulgogi::Query query(req);
+
+    // Optional search budget, 0 / absent = unlimited
+    uint32_t budget_ms = 0;
+    uint32_t max_nodes = 0;
+    if (!read_param(query, "budget_ms", budget_ms, res) || !read_param(query, "max_nodes", max_nodes, res)) return;
+
+    // Next page of an earlier paginated search
+    if (const auto token = query.text("cursor")) {
+        size_t page_size = 0;
+        if (!resolve_page_size(query, res, 64, 1024, page_size)) return;
+        const std::string key(*token);
+        auto cursor = g_fof_cursors.take(key);
+        if (!cursor) {
+            set_json(res, {{"error", "Unknown or expired cursor"}}, 410);
+            return;
+        }
+        const auto budget = social::SearchBudget::from_limits(budget_ms, max_nodes);
+        social::SearchStats stats{};
+        std::vector<uint32_t> page;
+        try {
+            page = cursor->next(*g_user_handler, page_size, budget, &stats);
+        } catch (const std::exception &e) {
+            // next() rewound the cursor to this page, the client may retry the same token
+            g_fof_cursors.put_back(key, std::move(*cursor));
+            set_json(res, {{"error", e.what()}}, 500);
+            return;
+        }
+        send_ids(req, res, "recommendations", page,
+                 {true, next_cursor(std::move(*cursor), g_fof_cursors, &stats), &stats});
+        return;
+    }
+
+    uint32_t user_id = 0;
+    if (!require_param(query, "id", user_id, res, "Missing user ID")) return;
+
+    // mode=search (default): A* over the friend graph; mode=beam: A* over the top-`beam` ties of every node;
+    // mode=common: most common friends, from the per-user table;
+    // mode=parallel: same ranking as search, each level of the frontier expanded on several threads
+    const std::string_view mode = query.text("mode").value_or("search");
+    if (mode != "search" && mode != "beam" && mode != "common" && mode != "parallel") {
+        set_json(res, {{"error", "Unknown mode"}, {"expected", "search, beam, common, parallel"}}, 400);
         return;
     }
-    uint32_t user_id = std::stoul(*params);
+
+    // Beam widths are compile-time, only these are instantiated
+    const std::string_view beam = query.text("beam").value_or("16");
+    if (beam != "8" && beam != "16" && beam != "32") {
+        set_json(res, {{"error", "Unknown beam width"}, {"expected", "8, 16, 32"}}, 400);
+        return;
+    }
+    uint32_t depth_param = 4;
+    if (!read_param(query, "depth", depth_param, res)) return;
+    const auto depth = static_cast<uint8_t>(std::clamp<uint32_t>(depth_param, 1, 16));
+
+    // page_size: resumable search, the response carries the cursor of the next page
+    const bool paginated = query.contains("page_size");
+    if (paginated && mode != "search") {
+        set_json(res, {{"error", "page_size is only supported by mode=search"}}, 400);
+        return;
+    }
+    size_t page_size = 0;
+    if (paginated && !resolve_page_size(query, res, 64, 1024, page_size)) return;
+
     try {
+        // Starts before the first DB read, the budget covers the whole request
+        const auto budget = social::SearchBudget::from_limits(budget_ms, max_nodes);
+        social::SearchStats stats{};
+
         const auto user = g_user_handler->load_user_by_id(user_id);
-        auto result = social::recommend_A_star<64>(user, *g_user_handler);
-        boost::json::array recommendations_json;
-        for (const jh::pod::pod_like auto &id: result) {
-            if (id == INVALID_FRIEND_ID) continue; // Skip invalid entries
-            recommendations_json.emplace_back(id);
+        if (paginated) {
+            social::FofCursor cursor(user, depth);
+            const auto page = cursor.next(*g_user_handler, page_size, budget, &stats);
+            send_ids(req, res, "recommendations", page,
+                     {true, next_cursor(std::move(cursor), g_fof_cursors, &stats), &stats});
+            return;
+        }
+
+        pod::array<uint32_t, 64> result{};
+        if (mode == "common") {
+            result = social::recommend_common_friends<64>(user, *g_user_handler);
+        } else if (mode == "search") {
+            result = social::recommend_A_star<64>(user, *g_user_handler, depth, budget, &stats);
+        } else if (mode == "parallel") {
+            // workers share the loads through the cache, the handler itself is single-connection
+            social::BatchGraphCache cache(*g_user_handler);
+            cache.prefetch({user_id});
+            result = social::recommend_A_star_parallel<64>(user, cache, depth, budget, &stats);
+        } else if (beam == "8") {
+            result = social::recommend_beam<64, 8>(user, *g_user_handler, depth, budget, &stats);
+        } else if (beam == "16") {
+            result = social::recommend_beam<64, 16>(user, *g_user_handler, depth, budget, &stats);
+        } else {
+            result = social::recommend_beam<64, 32>(user, *g_user_handler, depth, budget, &stats);
         }
-        set_json(res, {{"recommendations", recommendations_json}});
+        send_ids(req, res, "recommendations", filled_ids(result), {false, std::nullopt, &stats});
     } catch (const std::exception &e) {
         set_json(res, {{"error", e.what()}}, 500);
     }
 
 }
 
+REGISTER_VIEW(api, batch_recommend_fof) {
+    // recommend_fof for many users, searches share one graph cache
+    if (!check_method(req, bulgogi::http::verb::post, res)) return;
+    if (!ensure_mysql_ready(res, g_mysql_conn)) return;
+
+    auto body = json::parse(req.body());
+    if (!body.is_array()) {
+        set_json(res, {{"error", "Invalid request format"}}, 400);
+        return;
+    }
+
+    std::vector<uint32_t> user_ids;
+    for (const auto &id: body.as_array()) {
+        if (!id.is_int64()) continue; // Skip invalid IDs
+        user_ids.push_back(static_cast<uint32_t>(id.as_int64()));
+    }
+    if (user_ids.size() > social::FOF_BATCH_MAX) {
+        set_json(res, {{"error", "Too many user IDs"}, {"max", social::FOF_BATCH_MAX}}, 400);
+        return;
+    }
+
+    try {
+        const auto batch = social::recommend_A_star_batch<64>(user_ids, *g_user_handler);
+        bulgogi::write_json(res, [&](bulgogi::JsonWriter &json) {
+            json.begin_object().key("results").begin_array();
+            for (const auto &[user_id, recommendations, error]: batch) {
+                json.begin_object().key("id").value(user_id);
+                if (!error.empty()) {
+                    json.key("error").value(error);
+                } else {
+                    json.key("recommendations");
+                    write_ids(json, recommendations);
+                }
+                json.end_object();
+            }
+            json.end_array().end_object();
+        }, 200, batch.size() * (64 * ID_JSON_BYTES + 48) + 16);
+    } catch (const std::exception &e) {
+        set_json(res, {{"error", e.what()}}, 500);
+    }
+}
+
 REGISTER_VIEW(api, recommend_strangers) {
     // use social::recommend_strangers
     if (!check_method(req, bulgogi::http::verb::get, res)) return;
     if (!ensure_mysql_ready(res, g_mysql_conn)) return;
 
-    auto params = bulgogi::get_query_param(req, "id");
-    if (!params) {
-        set_json(res, {{"error", "Missing user ID"}}, 400);
+    const bulgogi::Query query(req);
+    const bool paginated = query.contains("page_size");
+    size_t page_size = 0;
+    if (!resolve_page_size(query, res, 20, STRANGER_POOL, page_size)) return;
+
+    // Next page of an earlier paginated ranking
+    if (const auto token = query.text("cursor")) {
+        auto pool = g_stranger_pools.take(std::string(*token));
+        if (!pool) {
+            set_json(res, {{"error", "Unknown or expired cursor"}}, 410);
+            return;
+        }
+        const auto page = pool->next(page_size);
+        send_ids(req, res, "recommendations", page, {true, next_cursor(std::move(*pool), g_stranger_pools)});
+        return;
+    }
+
+    uint32_t user_id = 0;
+    if (!require_param(query, "id", user_id, res, "Missing user ID")) return;
+
+    // mode=sample (default): interest-filtered SQL sample; mode=exact: best match_basics over everyone;
+    // mode=scan: best match_basics + match_interests over everyone
+    const std::string_view mode = query.text("mode").value_or("sample");
+    if (mode != "sample" && mode != "exact" && mode != "scan") {
+        set_json(res, {{"error", "Unknown mode"}, {"expected", "sample, exact, scan"}}, 400);
         return;
     }
-    uint32_t user_id = std::stoul(*params);
+
     try {
         auto user = g_user_handler->load_user_by_id(user_id);
-        auto recommendations = social::recommend_strangers<20>(user, *g_user_handler);
-        boost::json::array recommendations_json;
-        for (const jh::pod::pod_like auto &id: recommendations) {
-            if (id != INVALID_FRIEND_ID) {
-                recommendations_json.emplace_back(id);
-            } else break; // Reach end of valid recommendations
+
+        // page_size: rank STRANGER_POOL candidates once, later pages are slices of that ranking
+        if (paginated) {
+            const auto ranked = mode == "exact"
+                                ? social::recommend_strangers_exact<STRANGER_POOL>(user, *g_user_handler)
+                                : mode == "scan"
+                                  ? social::recommend_strangers_scan<STRANGER_POOL>(user, *g_user_handler)
+                                  : social::recommend_strangers<STRANGER_POOL>(user, *g_user_handler);
+            social::RankedPool pool;
+            for (const jh::pod::pod_like auto &id: ranked) {
+                if (id == INVALID_FRIEND_ID) break;
+                pool.ids.push_back(id);
+            }
+            const auto page = pool.next(page_size);
+            send_ids(req, res, "recommendations", page, {true, next_cursor(std::move(pool), g_stranger_pools)});
+            return;
         }
-        set_json(res, {{"recommendations", recommendations_json}});
+
+        auto recommendations = mode == "exact"
+                               ? social::recommend_strangers_exact<20>(user, *g_user_handler)
+                               : mode == "scan"
+                                 ? social::recommend_strangers_scan<20>(user, *g_user_handler)
+                                 : social::recommend_strangers<20>(user, *g_user_handler);
+        send_ids(req, res, "recommendations", filled_ids(recommendations));
     } catch (const std::exception &e) {
         set_json(res, {{"error", e.what()}}, 500);
     }
@@ -311,20 +836,21 @@ REGISTER_VIEW(api, get_user_friends) {
     if (!check_method(req, bulgogi::http::verb::get, res)) return;
     if (!ensure_mysql_ready(res, g_mysql_conn)) return;
 
-    auto params = bulgogi::get_query_param(req, "id");
-    if (!params) {
-        set_json(res, {{"error", "Missing user ID"}}, 400);
+    const bulgogi::Query query(req);
+    uint32_t user_id = 0;
+    if (!require_param(query, "id", user_id, res, "Missing user ID")) return;
+
+    // JSON and the binary list are different bytes, so different strong tags
+    const std::string etag = user_etag(user_id, bulgogi::accepts_id_list(req) ? "bin" : "json");
+    if (bulgogi::set_not_modified(req, res, etag)) {
+        res.set(bulgogi::http::field::vary, "Accept");
         return;
     }
 
-    uint32_t user_id = std::stoul(*params);
     try {
         auto friends = fabric::api::get_user_friends(user_id, *g_user_handler, *g_fabric_handler);
-        boost::json::array friends_json;
-        for (uint32_t fid: friends) {
-            friends_json.emplace_back(fid);
-        }
-        set_json(res, {{"friends", friends_json}});
+        send_ids(req, res, "friends", friends);
+        bulgogi::set_etag(res, etag);
     } catch (const std::exception &e) {
         set_json(res, {{"error", e.what()}}, 500);
     }
@@ -376,12 +902,14 @@ REGISTER_VIEW(api, set_db_connection) {
     auto dbname = json::value_to<std::string>(body.at("database"));
     auto port = json::value_to<uint32_t>(body.at("port"));
 
+    const bulgogi::Query query(req);
+    bool renew = false;
+    if (!read_param(query, "renew", renew, res)) return;
+
     try {
         // Disconnect
         views::atexit();
 
-        auto renew = bulgogi::get_query_param(req, "renew");
-
         // Reconnect with new config
         g_mysql_conn = mysql_init(nullptr);
         if (!mysql_real_connect(g_mysql_conn, host.c_str(), user.c_str(), password.c_str(),
@@ -389,7 +917,7 @@ REGISTER_VIEW(api, set_db_connection) {
             throw std::runtime_error(mysql_error(g_mysql_conn));
         }
 
-        if (renew && *renew == "true") {
+        if (renew) {
             std::istringstream ss(db_source);
             std::string line, statement;
             int sql_id = 0;
@@ -418,8 +946,17 @@ REGISTER_VIEW(api, set_db_connection) {
         // Wait to be prepared
         std::this_thread::sleep_for(std::chrono::milliseconds(500));
 
-        g_user_handler = std::make_unique<social::UserModelHandler>(g_mysql_conn);
-        g_fabric_handler = std::make_unique<fabric::FabricInfoHandler>(g_mysql_conn);
+        {
+            std::unique_lock lock(g_handlers_mutex);
+            g_user_handler = std::make_unique<social::UserModelHandler>(g_mysql_conn);
+            g_fabric_handler = std::make_unique<fabric::FabricInfoHandler>(g_mysql_conn);
+            g_handlers_published = true;
+        }
+
+        g_ingest.start([](const social::interaction_input &batch) {
+            std::lock_guard lock(g_simulation_mutex);
+            if (g_user_handler) social::_batch_update_interactions(*g_user_handler, batch);
+        });
 
         set_json(res, {{"status", "connected"},
                        {"db",     dbname}});
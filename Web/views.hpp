@@ -6,6 +6,8 @@
 
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <boost/asio/awaitable.hpp>
 #include "bulgogi.hpp"
 #include "marcos.hpp"
 
@@ -14,9 +16,15 @@ namespace views {
 
     using HandlerFunc = void (*)(const bulgogi::Request &req, bulgogi::Response &res);
 
+    /// @brief A coroutine view: runs on the connection's io thread and may co_await (e.g. bulgogi::offload).
+    using AsyncHandlerFunc = boost::asio::awaitable<void> (*)(const bulgogi::Request &req, bulgogi::Response &res);
+
     // Declare global function map
     extern std::unordered_map<std::string, HandlerFunc> function_map;
 
+    // Coroutine views, registered by REGISTER_ASYNC_VIEW
+    extern std::unordered_map<std::string, AsyncHandlerFunc> async_function_map;
+
     /**
      * @brief Register a view handler for a nested URL path.
      *
@@ -39,6 +47,34 @@ namespace views {
         } EXPAND(ROUTE_NAME(__VA_ARGS__), _registrar_instance); \
         void ROUTE_NAME(__VA_ARGS__)(const bulgogi::Request& req, bulgogi::Response& res)
 
+    /**
+     * @brief Register a coroutine view for a nested URL path, same path rules as REGISTER_VIEW.
+     *
+     * The body is a coroutine returning `boost::asio::awaitable<void>` and is driven on the io thread
+     * of its connection instead of the handler pool, so it must never block there: hand database
+     * calls and searches to bulgogi::offload and co_await the result. `req` and `res` stay valid until
+     * the coroutine finishes. If a sync and a coroutine view share a route, the coroutine view wins.
+     * Coroutine views skip load shedding unless they offload through bulgogi::admitted_offload, which
+     * answers 503 for them when the server or the route is full.
+     *
+     * Example:
+     * @code
+     * REGISTER_ASYNC_VIEW(api, user_name) {
+     *     if (!check_method(req, bulgogi::http::verb::get, res)) co_return;
+     *     auto name = co_await bulgogi::offload([] { return load_name_from_db(); });
+     *     set_json(res, {{"name", name}});
+     * }
+     * @endcode
+     */
+#define REGISTER_ASYNC_VIEW(...) \
+        boost::asio::awaitable<void> ROUTE_NAME(__VA_ARGS__)(const bulgogi::Request& req, bulgogi::Response& res); \
+        struct EXPAND(ROUTE_NAME(__VA_ARGS__), _async_registrar) { \
+            EXPAND(ROUTE_NAME(__VA_ARGS__), _async_registrar)() { \
+                views::async_function_map[ROUTE_STR(__VA_ARGS__)] = ROUTE_NAME(__VA_ARGS__); \
+            } \
+        } EXPAND(ROUTE_NAME(__VA_ARGS__), _async_registrar_instance); \
+        boost::asio::awaitable<void> ROUTE_NAME(__VA_ARGS__)(const bulgogi::Request& req, bulgogi::Response& res)
+
     /**
      * @brief Register one or more URL paths for a single handler function.
      *
@@ -113,8 +149,8 @@ namespace views {
 
     // Returns true if a view exists for this path
     inline bool has_route(std::string_view path) {
-        if (path.empty()) return function_map.contains("");
-        if (path[0] == '/') path.remove_prefix(1);
-        return function_map.contains(std::string(path));
+        if (!path.empty() && path[0] == '/') path.remove_prefix(1);
+        const std::string key(path);
+        return function_map.contains(key) || async_function_map.contains(key);
     }
 }
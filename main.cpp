@@ -14,6 +14,11 @@
 #include <vector>
 #include <mutex>
 #include "Web/views.hpp"
+#include "Web/router.hpp"
+#include "Web/compress.hpp"
+#include "Web/async.hpp"
+#include "Web/metrics.hpp"
+#include "Web/admission.hpp"
 
 
 namespace beast = boost::beast;
@@ -24,13 +29,13 @@ namespace json = boost::json;
 using tcp = boost::asio::ip::tcp;
 
 std::atomic g_should_exit = false;
+/// Bound to its own strand: only handlers on global_acceptor->get_executor() may touch it once ioc runs.
 std::unique_ptr<tcp::acceptor> global_acceptor;
 
-std::vector<std::thread> session_threads;
-std::mutex session_mutex;
-
+/// Runs on the acceptor's strand (see main), the only place it may be closed from.
 void handle_signal(const int signal) {
     if (signal == SIGTERM || signal == SIGINT) {
+        g_should_exit = true;
         if (global_acceptor) {
             boost::system::error_code ec;
             auto err = global_acceptor->close(ec);
@@ -39,84 +44,192 @@ void handle_signal(const int signal) {
     }
 }
 
-std::unordered_map<std::string, views::HandlerFunc> build_route_map() {
-    std::unordered_map<std::string, views::HandlerFunc> map;
-    for (const auto &[name, func]: views::function_map) {
-        map["/" + name] = func;
+/// Error body of a view that threw.
+void set_view_error(bulgogi::Response& res, [[maybe_unused]] const std::exception& e) {
+#ifndef NDEBUG
+    bulgogi::set_json(res, {{"error", e.what()}}, 400);
+#else
+    bulgogi::set_json(res, {{"error", "Internal Server Error"}}, 500);
+#endif
+}
+
+/// OPTIONS preflight checks shared by both kinds of views, @return true if @p res is already final.
+bool reject_preflight(const bulgogi::Router::Route* route,
+                      const http::request<http::string_body>& req,
+                      http::response<http::string_body>& res) {
+    if (route) {
+        try {
+            views::check_head(req);  // allow filtering on Origin / Headers
+            res.result(http::status::no_content);
+        } catch (const std::exception& e) {
+            bulgogi::set_json(res, {
+                    {"error", std::string("CORS preflight rejected: ") + e.what()}
+            }, 403);
+            bulgogi::apply_cors(res);  // optional for visibility
+            return true;
+        } // legal, continue to regular request handling to get full cors
+        return false;
     }
-    return map;
+    bulgogi::set_text(res, "404 Not Found (CORS preflight): " + std::string(req.target()), 404);
+    bulgogi::apply_cors(res);  // optional for visibility
+    return true;
 }
 
+/// Run @p route's view for @p req; @p route is null for paths no view serves.
 void handle_request(
-        const std::unordered_map<std::string, views::HandlerFunc>& route_map,
+        const bulgogi::Router::Route* route,
         const http::request<http::string_body>& req,
         http::response<http::string_body>& res) {
 
     res.version(req.version());
     res.keep_alive(req.keep_alive());
 
-    const std::string target = std::string(req.target());
-    const auto query_pos = target.find('?');
-    const std::string route = query_pos == std::string::npos ? target : target.substr(0, query_pos);
-
     // === Special handling for OPTIONS preflight ===
-    if (req.method() == http::verb::options) {
-        if (views::has_route(route)) {
-            try {
-                views::check_head(req);  // allow filtering on Origin / Headers
-                res.result(http::status::no_content);
-            } catch (const std::exception& e) {
-                bulgogi::set_json(res, {
-                        {"error", std::string("CORS preflight rejected: ") + e.what()}
-                }, 403);
-                bulgogi::apply_cors(res);  // optional for visibility
-                return;
-            } // legal, continue to regular request handling to get full cors
-        } else {
-            bulgogi::set_text(res, "404 Not Found (CORS preflight): " + route, 404);
-            bulgogi::apply_cors(res);  // optional for visibility
-            return;
-        }
-    }
+    if (req.method() == http::verb::options && reject_preflight(route, req, res)) return;
 
     // === Regular request handling ===
-    auto it = route_map.find(route);
-    if (it != route_map.end()) {
+    if (route && route->sync) {
         bulgogi::Response hres;
 
         try {
-            it->second(req, hres);
+            route->sync(req, hres);
         } catch (const std::exception& e) {
-#ifndef NDEBUG
-            bulgogi::set_json(hres, {{"error", e.what()}}, 400);
-#else
-            bulgogi::set_json(hres, {{"error", "Internal Server Error"}}, 500);
-#endif
+            set_view_error(hres, e);
         }
 
         res = std::move(hres);
+        res.version(req.version()); // the view built a fresh response
+        res.keep_alive(req.keep_alive());
+        bulgogi::compress_response(req, res); // still on the handler thread
     } else {
-        bulgogi::set_text(res, "404 Not Found: " + route, 404);
+        bulgogi::set_text(res, "404 Not Found: /" + std::string(bulgogi::Router::route_of(req.target())), 404);
+    }
+}
+
+/// 503 for a request the admission gate turned away, answered on the io thread without touching a view.
+void shed_request(const http::request<http::string_body>& req,
+                  http::response<http::string_body>& res,
+                  const bulgogi::Admission::Verdict verdict) {
+    const auto retry_after = bulgogi::admission().config().retry_after;
+    bulgogi::set_json(res, {{"error", verdict == bulgogi::Admission::Verdict::route_busy
+                                      ? "Route busy" : "Server overloaded"},
+                            {"retry_after", retry_after}}, 503);
+    res.set(http::field::retry_after, std::to_string(retry_after));
+    bulgogi::apply_cors(res);
+    res.version(req.version());
+    res.keep_alive(req.keep_alive());
+}
+
+/// handle_request for a coroutine view, runs on the connection's io thread.
+net::awaitable<void> handle_async_request(
+        const bulgogi::Router::Route& route,
+        const http::request<http::string_body>& req,
+        http::response<http::string_body>& res) {
+
+    res.version(req.version());
+    res.keep_alive(req.keep_alive());
+
+    if (req.method() == http::verb::options && reject_preflight(&route, req, res)) co_return;
+
+    bulgogi::Response hres;
+    try {
+        co_await route.async(req, hres);
+    } catch (const bulgogi::Shed& shed) {
+        shed_request(req, res, shed.verdict); // admitted_offload found no room
+        co_return;
+    } catch (const std::exception& e) {
+        set_view_error(hres, e);
+    }
+
+    res = std::move(hres);
+    res.version(req.version());
+    res.keep_alive(req.keep_alive());
+    // Deflating is CPU work: bodies large enough to be compressed at all (e.g. /metrics) leave the io thread
+    if (res.body().size() >= COMPRESS_MIN_BYTES) {
+        co_await bulgogi::offload([&req, &res] { bulgogi::compress_response(req, res); });
     }
 }
 
-void do_session(tcp::socket socket,
-                const std::shared_ptr<const std::unordered_map<std::string, views::HandlerFunc>> &route_map) {
+/**
+ * One connection: read on the io threads, run the view on the blocking pool, write on the io threads.
+ *
+ * Keep-alive: requests are served in a loop until the client asks to close, KEEP_ALIVE_MAX requests
+ * were served, or no new request starts within KEEP_ALIVE_TIMEOUT seconds. Pipelined requests already
+ * sit in the buffer and are answered strictly in order. TIMEOUT bounds each request from its first
+ * byte to the end of its response.
+ */
+net::awaitable<void> do_session(tcp::socket socket,
+                                const std::shared_ptr<const bulgogi::Router> router) {
+    beast::tcp_stream stream(std::move(socket));
+    beast::flat_buffer buffer;
+    uint64_t served = 0;
+    bulgogi::connection_metrics().opened();
+
     try {
-        beast::flat_buffer buffer;
-        http::request<http::string_body> req;
+        while (!g_should_exit) {
+            // Idle: wait for the first byte of the next request unless it is already buffered
+            if (buffer.size() == 0) {
+                stream.expires_after(std::chrono::seconds(served == 0 ? TIMEOUT : KEEP_ALIVE_TIMEOUT));
+                boost::system::error_code ec;
+                const size_t n = co_await stream.async_read_some(buffer.prepare(4096),
+                                                                 net::redirect_error(net::use_awaitable, ec));
+                if (ec == beast::error::timeout) {
+                    // tcp_stream already closed the socket
+                    if (served > 0) bulgogi::connection_metrics().idle_timeout();
+                    bulgogi::connection_metrics().closed(served);
+                    co_return;
+                }
+                if (ec == net::error::eof) break; // client closed between requests
+                if (ec) throw beast::system_error(ec);
+                buffer.commit(n);
+            }
+
+            http::request_parser<http::string_body> parser;
+            parser.body_limit(BODY_LIMIT);
 
-        beast::tcp_stream stream(std::move(socket));
-        stream.expires_after(std::chrono::seconds(TIMEOUT));
+            stream.expires_after(std::chrono::seconds(TIMEOUT));
+            co_await http::async_read(stream, buffer, parser, net::use_awaitable);
+            http::request<http::string_body> req = parser.release();
 
-        http::read(stream, buffer, req);
+            if (g_should_exit) break;
 
-        if (g_should_exit) return;
+            const auto started = std::chrono::steady_clock::now();
+            http::response<http::string_body> res;
+            const bulgogi::Router::Route* route = router->find(req.target());
+            const bool preflight = req.method() == http::verb::options;
 
-        http::response<http::string_body> res;
-        handle_request(*route_map, req, res);
+            // Only sync views take a handler thread here; coroutine views admit their own offloads
+            const bool blocking = route && !route->async && !preflight;
+            bulgogi::Admission::Verdict verdict{};
+            auto ticket = blocking ? bulgogi::admission().try_admit(route->path, verdict) : std::nullopt;
 
-        http::write(stream, res);
+            if (blocking && !ticket) {
+                shed_request(req, res, verdict);
+            } else if (route && route->async) {
+                // Coroutine views stay on this strand and offload their own blocking parts
+                co_await handle_async_request(*route, req, res);
+            } else if (preflight || !route) {
+                handle_request(route, req, res);
+            } else {
+                // Views block (MySQL, searches), keep them off the io threads
+                res = co_await bulgogi::offload([route, &req] {
+                    http::response<http::string_body> out;
+                    handle_request(route, req, out);
+                    return out;
+                });
+            }
+
+            // The response is ready, writing it is the client's pace: a slow reader must not hold a slot
+            ticket.reset();
+            bulgogi::request_metrics().record(route ? router->index_of(*route) : bulgogi::request_metrics().unmatched(),
+                                              res.result_int(), std::chrono::steady_clock::now() - started);
+
+            ++served;
+            if (served >= KEEP_ALIVE_MAX || g_should_exit) res.keep_alive(false);
+
+            co_await http::async_write(stream, res, net::use_awaitable);
+            if (!res.keep_alive()) break;
+        }
 
         boost::system::error_code ec;
         auto& sock = stream.socket();
@@ -141,62 +254,78 @@ void do_session(tcp::socket socket,
             std::cerr << "Session exception: " << e.what() << std::endl;
         }
     }
+
+    bulgogi::connection_metrics().closed(served);
+}
+
+/// Accept on the acceptor's strand until it is closed or cancelled (signal, shutdown_server); every socket gets its own strand.
+net::awaitable<void> do_listen(net::io_context &ioc,
+                               const std::shared_ptr<const bulgogi::Router> router) {
+    while (!g_should_exit) {
+        boost::system::error_code ec;
+        tcp::socket socket = co_await global_acceptor->async_accept(net::make_strand(ioc),
+                                                                    net::redirect_error(net::use_awaitable, ec));
+
+        if (ec == boost::asio::error::operation_aborted || ec == boost::asio::error::bad_descriptor) break;
+
+        if (ec) {
+            std::cerr << "Accept error: " << ec.message() << std::endl;
+            continue;
+        }
+
+        if (g_should_exit) break;
+
+        auto executor = socket.get_executor();
+        net::co_spawn(executor, do_session(std::move(socket), router), net::detached);
+    }
 }
 
 
 int main() {
-    std::signal(SIGINT, handle_signal);
-    std::signal(SIGTERM, handle_signal);
     views::init();
 
-    auto route_map = std::make_shared<std::unordered_map<std::string, views::HandlerFunc>>(build_route_map());
+    // Registration is over, freeze the routes
+    auto router = std::make_shared<const bulgogi::Router>(views::function_map, views::async_function_map);
     std::cout << "Registered routes:" << std::endl;
-    for (const auto &[name, _]: *route_map) {
-        std::cout << name << std::endl;
+    std::vector<std::string> route_names;
+    for (const auto &route: router->routes()) {
+        std::cout << "/" << route.path << (route.async ? " (async)" : "") << std::endl;
+        route_names.push_back(route.path);
     }
+    bulgogi::request_metrics().init(std::move(route_names));
 
     try {
-        net::io_context ioc{1};
-        global_acceptor = std::make_unique<tcp::acceptor>(ioc, tcp::endpoint{tcp::v4(), PORT});
+        const unsigned io_threads = IO_THREADS > 0 ? IO_THREADS : std::max(1u, std::thread::hardware_concurrency());
 
-        auto io_runner = [&ioc]() {
-            ioc.run();
-        };
-        std::thread(std::move(io_runner)).detach();
+        net::io_context ioc{static_cast<int>(io_threads)};
+        // Several io threads run ioc: the listener, signals and shutdown_server meet on one strand
+        global_acceptor = std::make_unique<tcp::acceptor>(net::make_strand(ioc), tcp::endpoint{tcp::v4(), PORT});
+        const auto acceptor_strand = global_acceptor->get_executor();
 
-        std::cout << "HTTP server running on port " STR(PORT) "..." << std::endl;
+        net::signal_set signals(ioc, SIGINT, SIGTERM);
+        signals.async_wait(net::bind_executor(acceptor_strand, [](const boost::system::error_code &ec, const int signal) {
+            if (!ec) handle_signal(signal);
+        }));
 
-        while (!g_should_exit) {
-            tcp::socket socket{ioc};
+        net::co_spawn(acceptor_strand, do_listen(ioc, router), [&signals](const std::exception_ptr &) {
+            // Listener gone: stop waiting for signals, ioc.run() returns once the open sessions finish
             boost::system::error_code ec;
-            auto err = global_acceptor->accept(socket, ec);
-            (void) err;
+            signals.cancel(ec);
+        });
 
-            if (ec == boost::asio::error::operation_aborted) break;
-
-            if (ec) {
-                std::cerr << "Accept error: " << ec.message() << std::endl;
-                continue;
-            }
+        std::cout << "HTTP server running on port " STR(PORT) " with " << io_threads << " io threads, "
+                  << HANDLER_THREADS << " handler threads..." << std::endl;
 
-            auto session = [sock = std::move(socket), route_map]() mutable {
-                do_session(std::move(sock), route_map);
-            };
-            std::lock_guard<std::mutex> lock(session_mutex);
-            session_threads.emplace_back(std::move(session));
+        std::vector<std::thread> io_pool;
+        io_pool.reserve(io_threads - 1);
+        for (unsigned i = 1; i < io_threads; ++i) {
+            io_pool.emplace_back([&ioc] { ioc.run(); });
         }
+        ioc.run();
+        for (auto &t: io_pool) t.join();
 
-        ioc.stop();
         global_acceptor.reset();
-
-        {
-            std::lock_guard lock(session_mutex);
-            for (size_t i = 0; i < session_threads.size(); ++i) { // NOLINT ranged-for illegal
-                if (session_threads.at(i).joinable()) {
-                    session_threads.at(i).join();
-                }
-            }
-        }
+        bulgogi::blocking_pool().join();
 
         std::cout << "\U0001F44B Server exiting, cleaning up...\n";
         views::atexit();
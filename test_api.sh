@@ -49,4 +49,52 @@ if [ -n "$RECOMMENDED_ID" ]; then
     curl -s "${BASE_URL}/get_user_profile_simple?id=$RECOMMENDED_ID" | jq
 else
     echo "❗ No stranger recommendations found."
-fi
\ No newline at end of file
+fi
+
+# Step 8: Ingest interactions (202 accepted, 400 bad score, 413 larger than the queue, 429 queue full)
+echo "📥 Ingesting NDJSON interactions..."
+curl -s -X POST "${BASE_URL}/ingest_interactions" \
+  -H "Content-Type: application/x-ndjson" \
+  --data-binary $'{"user1_id": 1, "user2_id": 2, "score": 3}\n{"user2_id": 3, "user1_id": 1, "score": 1}\n' | jq
+
+echo "🚫 Score out of range (expect 400):"
+curl -s -o /dev/null -w '%{http_code}\n' -X POST "${BASE_URL}/ingest_interactions" \
+  -H "Content-Type: application/x-ndjson" \
+  --data-binary '{"user1_id": 1, "user2_id": 2, "score": 0}'
+
+# Packed records (1, 2, 1): CAPACITY + 1 of them for 413, exactly CAPACITY to fill the queue
+CAPACITY=$((1 << 20))
+python3 -c "import sys; sys.stdout.buffer.write(bytes([1,0,0,0, 2,0,0,0, 1,0,0,0]) * ($CAPACITY + 1))" > /tmp/ingest_over.bin
+python3 -c "import sys; sys.stdout.buffer.write(bytes([1,0,0,0, 2,0,0,0, 1,0,0,0]) * $CAPACITY)" > /tmp/ingest_full.bin
+
+echo "📦 Batch larger than the ingest queue (expect 413):"
+curl -s -o /dev/null -w '%{http_code}\n' -X POST "${BASE_URL}/ingest_interactions" \
+  -H "Content-Type: application/octet-stream" \
+  --data-binary @/tmp/ingest_over.bin
+
+# The first full batch goes to the updater, the second waits in the queue, the third does not fit
+echo "🚦 Three full batches in a row (expect 202, 202, 429 with Retry-After):"
+for _ in 1 2 3; do
+  curl -s -o /dev/null -w '%{http_code} Retry-After: %header{retry-after}\n' -X POST "${BASE_URL}/ingest_interactions" \
+    -H "Content-Type: application/octet-stream" \
+    --data-binary @/tmp/ingest_full.bin
+done
+
+# Step 9: Keep-alive, three requests over one connection (new connections: 1, 0, 0)
+echo "🔁 Reusing one connection:"
+curl -s -o /dev/null -o /dev/null -o /dev/null -w '%{http_code} new connections: %{num_connects}\n' \
+  "${BASE_URL}/server_metrics" "${BASE_URL}/server_metrics" "${BASE_URL}/get_user_profile?id=$USER_ID"
+
+# Step 10: Binary id list, magic BGID then a uint32 count and the ids (little-endian)
+echo "🧮 FOF Recommendations as a binary id list:"
+curl -s -D /tmp/fof_bin.headers -o /tmp/fof.bin -H "Accept: application/octet-stream" \
+  "${BASE_URL}/recommend_fof?id=$USER_ID"
+grep -i -E '^(content-type|vary|x-partial):' /tmp/fof_bin.headers
+echo "magic: $(head -c 4 /tmp/fof.bin)"
+od -A n -t u4 -j 4 /tmp/fof.bin | head -n 3
+
+# Step 11: Conditional GET, the ETag of an unchanged profile answers 304 without a body
+echo "🏷️ Conditional profile request (expect 304):"
+ETAG=$(curl -s -D - -o /dev/null "${BASE_URL}/get_user_profile?id=$USER_ID" | grep -i '^etag:' | cut -d' ' -f2 | tr -d '\r')
+echo "👉 ETag: $ETAG"
+curl -s -o /dev/null -w '%{http_code}\n' -H "If-None-Match: $ETAG" "${BASE_URL}/get_user_profile?id=$USER_ID"
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdlib>
+#include <iostream>
+
+/// assert() that stays in Release builds: report the failed condition and exit non-zero for ctest.
+#define CHECK(cond)                                                                              \
+    do {                                                                                         \
+        if (!(cond)) {                                                                           \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #cond << std::endl;   \
+            std::exit(1);                                                                        \
+        }                                                                                        \
+    } while (0)
@@ -0,0 +1,45 @@
+#pragma once
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "../Entities/UserModel.hpp"
+#include "../Application/UserModelHandler.hpp"
+
+namespace tests {
+
+    /// Random users with mutual friend lists, read through the Source interface of the searches.
+    struct GraphSource {
+        std::vector<social::UserModel> users;
+
+        GraphSource(const uint32_t count, const uint32_t degree, const uint64_t seed) : users(count + 1) {
+            std::mt19937_64 rng(seed);
+            for (uint32_t id = 1; id <= count; ++id) {
+                users[id].user_id = id;
+                users[id].interests_16 = rng();
+                users[id].base_64_bits = rng();
+            }
+            for (uint32_t id = 1; id <= count; ++id) {
+                for (uint32_t k = 0; k < degree; ++k) {
+                    const auto other = static_cast<uint32_t>(rng() % count + 1);
+                    if (other == id || social::find_friend_index(users[id], other) != INVALID_INDEX) continue;
+                    const auto score = static_cast<uint32_t>(rng() % 100 + 1);
+                    if (social::find_insertable_friend_slot(users[id]) == INVALID_INDEX ||
+                        social::find_insertable_friend_slot(users[other]) == INVALID_INDEX) continue;
+                    social::add_friend(users[id], other, score);
+                    social::add_friend(users[other], id, score);
+                }
+            }
+        }
+
+        [[nodiscard]] const social::UserModel &load_user_by_id(const uint32_t id) const {
+            if (id == 0 || id >= users.size()) throw std::runtime_error("no such user");
+            return users[id];
+        }
+
+        [[nodiscard]] social::UserProfileView get_user_profile_view(const uint32_t id) const {
+            const auto &u = load_user_by_id(id);
+            return {id, u.interests_16, u.base_64_bits};
+        }
+    };
+
+}
@@ -0,0 +1,102 @@
+// recommend_A_star (Dial bucket queue) against the binary-heap A* it replaced, on an in-memory graph.
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "../Application/Business.hpp"
+#include "check.hpp"
+#include "graph_source.hpp"
+
+fabric::rng_engine &global_rng() {
+    thread_local fabric::rng_engine rng(36);
+    return rng;
+}
+
+namespace {
+
+    /// The priority_queue A* recommend_A_star replaced: same costs, (cost, user_id) order and budget rules.
+    template<size_t N>
+    pod::array<uint32_t, N> heap_A_star(const social::UserModel &self, const tests::GraphSource &ctrl,
+                                        const uint8_t max_depth, const social::SearchBudget &budget,
+                                        social::SearchStats &stats) {
+        struct Node {
+            uint32_t user_id;
+            uint8_t cost;
+            uint8_t depth;
+
+            bool operator>(const Node &other) const {
+                return cost != other.cost ? cost > other.cost : user_id > other.user_id;
+            }
+        };
+
+        std::priority_queue<Node, std::vector<Node>, std::greater<>> open;
+        std::unordered_map<uint32_t, uint8_t> best_cost;
+        std::unordered_set<uint32_t> recommended;
+        std::unordered_map<uint32_t, social::UserProfileView> profiles;
+
+        pod::array<uint32_t, N> result{};
+        size_t filled = 0;
+        stats = {};
+
+        open.push({self.user_id, 0, 0});
+        best_cost[self.user_id] = 0;
+
+        while (!open.empty() && filled < N) {
+            const Node current = open.top();
+            open.pop();
+
+            if (current.user_id != self.user_id && recommended.insert(current.user_id).second &&
+                !social::is_friend(self, current.user_id)) {
+                result[filled++] = current.user_id;
+            }
+            if (current.depth >= max_depth) continue;
+            if (stats.partial || stats.expansions >= budget.max_expansions) {
+                stats.partial = true;
+                continue;
+            }
+            ++stats.expansions;
+
+            const auto &node = ctrl.load_user_by_id(current.user_id);
+            ++stats.db_calls;
+            for (const auto &[fid, _]: node.friends) {
+                if (fid == INVALID_FRIEND_ID || profiles.contains(fid)) continue;
+                profiles[fid] = ctrl.get_user_profile_view(fid);
+                ++stats.db_calls;
+            }
+            for (const auto &[fid, _]: node.friends) {
+                if (fid == INVALID_FRIEND_ID || fid == self.user_id) continue;
+                const auto &prof = profiles.at(fid);
+                const auto new_cost = static_cast<uint8_t>(
+                        current.cost + social::_fof_edge_cost(self, prof.interests_16, prof.base_64_bits));
+                if (!best_cost.contains(fid) || new_cost < best_cost[fid]) {
+                    best_cost[fid] = new_cost;
+                    open.push({fid, new_cost, static_cast<uint8_t>(current.depth + 1)});
+                }
+            }
+        }
+        return result;
+    }
+
+}
+
+int main() {
+    for (const uint64_t seed: {1, 2}) {
+        const tests::GraphSource graph(5000, 10 + 20 * static_cast<uint32_t>(seed), seed);
+        for (uint32_t id = 1; id <= 60; ++id) {
+            for (const uint8_t depth: {1, 2, 4}) {
+                for (const uint32_t nodes: {0u, 5u, 50u}) {
+                    const auto budget = social::SearchBudget::from_limits(0, nodes);
+                    social::SearchStats heap{}, dial{};
+                    const auto expected = heap_A_star<64>(graph.users[id], graph, depth, budget, heap);
+                    const auto got = social::recommend_A_star<64>(graph.users[id], graph, depth, budget, &dial);
+
+                    CHECK(got == expected);
+                    CHECK(dial.expansions == heap.expansions);
+                    CHECK(dial.db_calls == heap.db_calls);
+                    CHECK(dial.partial == heap.partial);
+                }
+            }
+        }
+    }
+    return 0;
+}
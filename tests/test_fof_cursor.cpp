@@ -0,0 +1,115 @@
+// FofCursor pages against one recommend_A_star call, with and without failing loads; PaginationStore bounds.
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../Application/FofCursor.hpp"
+#include "../Application/PaginationStore.hpp"
+#include "check.hpp"
+#include "graph_source.hpp"
+
+fabric::rng_engine &global_rng() {
+    thread_local fabric::rng_engine rng(38);
+    return rng;
+}
+
+namespace {
+
+    /// GraphSource whose loads throw now and then, like a dropped database connection.
+    struct FlakySource {
+        const tests::GraphSource &graph;
+        mutable std::mt19937 rng{38};
+
+        [[nodiscard]] const social::UserModel &load_user_by_id(const uint32_t id) const {
+            fail();
+            return graph.load_user_by_id(id);
+        }
+
+        [[nodiscard]] social::UserProfileView get_user_profile_view(const uint32_t id) const {
+            fail();
+            return graph.get_user_profile_view(id);
+        }
+
+        void fail() const {
+            if (rng() % 50 == 0) throw std::runtime_error("lost connection");
+        }
+    };
+
+    /// A pagination state of a given size.
+    struct Sized {
+        size_t bytes;
+
+        [[nodiscard]] size_t memory_bytes() const { return bytes; }
+    };
+
+    /// The whole ranking one search produces, as a list.
+    std::vector<uint32_t> one_shot(const tests::GraphSource &graph, const uint32_t id, const uint8_t depth) {
+        std::vector<uint32_t> ids;
+        for (const uint32_t rec: social::recommend_A_star<4096>(graph.users[id], graph, depth)) {
+            if (rec == INVALID_FRIEND_ID) break;
+            ids.push_back(rec);
+        }
+        return ids;
+    }
+
+}
+
+int main() {
+    const tests::GraphSource graph(3000, 8, 38);
+
+    for (uint32_t id = 1; id <= 30; ++id) {
+        for (const uint8_t depth: {2, 3}) {
+            const auto expected = one_shot(graph, id, depth);
+
+            // The first page of 64 is the plain call
+            social::FofCursor first(graph.users[id], depth);
+            const auto page = first.next(graph, 64);
+            const auto plain = social::recommend_A_star<64>(graph.users[id], graph, depth);
+            for (size_t i = 0; i < plain.size(); ++i) {
+                CHECK((i < page.size() ? page[i] : INVALID_FRIEND_ID) == plain[i]);
+            }
+
+            // Pages concatenate to the one-shot order, whatever the page size and per-page budget
+            for (const size_t page_size: {1, 7, 64, 500}) {
+                for (const uint32_t nodes: {0u, 1u, 5u}) {
+                    social::FofCursor cursor(graph.users[id], depth);
+                    std::vector<uint32_t> got;
+                    while (!cursor.exhausted()) {
+                        const auto next = cursor.next(graph, page_size, social::SearchBudget::from_limits(0, nodes));
+                        got.insert(got.end(), next.begin(), next.end());
+                    }
+                    CHECK(got == expected);
+                }
+            }
+
+            // A page whose loads throw is served again in full by the next call
+            const FlakySource flaky{graph};
+            social::FofCursor cursor(graph.users[id], depth);
+            std::vector<uint32_t> got;
+            while (!cursor.exhausted()) {
+                try {
+                    const auto next = cursor.next(flaky, 7);
+                    got.insert(got.end(), next.begin(), next.end());
+                } catch (const std::runtime_error &) {}
+            }
+            CHECK(got == expected);
+        }
+    }
+
+    // Byte budget: older states make room, a state larger than the budget is refused
+    social::PaginationStore<Sized> store(100, 1000, std::chrono::minutes(1));
+    const auto a = store.put({400});
+    const auto b = store.put({400});
+    const auto c = store.put({400});
+    CHECK(a && b && c);
+    CHECK(store.bytes() <= 1000);
+    CHECK(!store.put({1001}));
+
+    // put_back keeps the token usable once more
+    auto state = store.take(*c);
+    CHECK(state.has_value());
+    store.put_back(*c, std::move(*state));
+    CHECK(store.take(*c).has_value());
+    CHECK(!store.take(*c).has_value());
+    return 0;
+}
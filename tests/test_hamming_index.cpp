@@ -0,0 +1,82 @@
+// HammingIndex::nearest against a linear scan over the same codes.
+#include <algorithm>
+#include <bit>
+#include <random>
+#include <vector>
+#include "../Entities/HammingIndex.hpp"
+#include "../Entities/UserModel.hpp"
+#include "check.hpp"
+
+namespace {
+
+    /// The K closest codes by brute force, ties by smaller id, in the shape nearest() returns.
+    template<size_t K, typename Exclude>
+    pod::array<pod::pair<uint32_t, uint8_t>, K>
+    linear_nearest(const std::vector<uint64_t> &codes, const uint64_t query, Exclude &&exclude) {
+        std::vector<std::pair<int, uint32_t>> all;
+        for (uint32_t id = 1; id < codes.size(); ++id) {
+            if (!exclude(id)) all.emplace_back(std::popcount(codes[id] ^ query), id);
+        }
+        std::sort(all.begin(), all.end());
+
+        pod::array<pod::pair<uint32_t, uint8_t>, K> result{};
+        for (size_t i = 0; i < std::min(K, all.size()); ++i) {
+            result[i] = {all[i].second, static_cast<uint8_t>(64 - all[i].first)};
+        }
+        return result;
+    }
+
+    template<size_t K, typename Exclude>
+    void check_query(const social::HammingIndex &index, const std::vector<uint64_t> &codes, const uint64_t query,
+                     Exclude &&exclude) {
+        CHECK((index.nearest<K>(query, exclude) == linear_nearest<K>(codes, query, exclude)));
+    }
+
+}
+
+int main() {
+    std::mt19937_64 rng(29);
+    constexpr uint32_t USERS = 20000;
+
+    // Clustered codes, so queries see many small distances and ties, not only ~32-bit ones
+    std::vector<uint64_t> centers(200);
+    for (auto &c: centers) c = rng();
+    const auto near = [&](const uint64_t center) {
+        return center ^ (rng() & rng() & rng() & rng());
+    };
+
+    social::HammingIndex index;
+    CHECK((index.nearest<4>(0, [](uint32_t) { return false; })[0].first == INVALID_FRIEND_ID));
+
+    std::vector<uint64_t> codes(USERS + 1);
+    for (uint32_t id = 1; id <= USERS; ++id) {
+        codes[id] = near(centers[rng() % centers.size()]);
+        index.insert(id, codes[id]);
+    }
+
+    const auto none = [](uint32_t) { return false; };
+    const auto sevens = [](const uint32_t id) { return id % 7 == 0; };
+    for (int q = 0; q < 200; ++q) {
+        const uint64_t query = q % 4 == 0 ? rng() : near(centers[rng() % centers.size()]);
+        check_query<1>(index, codes, query, none);
+        check_query<20>(index, codes, query, sevens);
+        check_query<64>(index, codes, query, none);
+    }
+
+    // Moved codes leave their old buckets
+    for (uint32_t id = 1; id <= USERS; id += 3) {
+        codes[id] = near(centers[rng() % centers.size()]);
+        index.insert(id, codes[id]);
+    }
+    for (int q = 0; q < 100; ++q) {
+        check_query<20>(index, codes, near(centers[rng() % centers.size()]), sevens);
+    }
+
+    // Fewer candidates than K: the tail stays empty
+    const auto most = [](const uint32_t id) { return id > 5; };
+    check_query<8>(index, codes, rng(), most);
+
+    index.clear();
+    CHECK((index.nearest<4>(codes[1], none)[0].first == INVALID_FRIEND_ID));
+    return 0;
+}
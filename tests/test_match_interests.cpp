@@ -0,0 +1,33 @@
+// match_interests_swar against the scalar match_interests.
+#include <random>
+#include "../Entities/UserModel.hpp"
+#include "check.hpp"
+
+static_assert(social::match_interests_swar(0, 0) == social::match_interests(0, 0));
+static_assert(social::match_interests_swar(0x0123456789ABCDEFULL, 0xFEDCBA9876543210ULL) ==
+              social::match_interests(0x0123456789ABCDEFULL, 0xFEDCBA9876543210ULL));
+
+int main() {
+    // Every level pair in every lane, the other lanes random
+    std::mt19937_64 rng(30);
+    for (uint32_t lane = 0; lane < 16; ++lane) {
+        for (uint64_t x = 0; x < 16; ++x) {
+            for (uint64_t y = 0; y < 16; ++y) {
+                const uint64_t clear = ~(uint64_t{0xF} << (4 * lane));
+                const uint64_t a = (rng() & clear) | x << (4 * lane);
+                const uint64_t b = (rng() & clear) | y << (4 * lane);
+                CHECK(social::match_interests_swar(a, b) == social::match_interests(a, b));
+            }
+        }
+    }
+
+    // Random pairs: unrelated, close (few differing bits) and equal
+    for (uint32_t i = 0; i < 2'000'000; ++i) {
+        const uint64_t a = rng();
+        uint64_t b = rng();
+        if (i % 3 == 1) b = a ^ (rng() & rng() & rng());
+        if (i % 3 == 2) b = a;
+        CHECK(social::match_interests_swar(a, b) == social::match_interests(a, b));
+    }
+    return 0;
+}